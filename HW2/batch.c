@@ -0,0 +1,338 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+// Work stealing: the job list is split into one contiguous range per worker.
+// A worker takes jobs from the front of its own range and, once that is
+// empty, steals the back half of the fullest other range. Each range is a
+// single atomic word (next << 32 | end), so owner and thieves agree through
+// compare-and-swap without locks, and long programs don't pin the others.
+typedef struct {
+    _Atomic uint64_t range;
+} JobRange;
+
+typedef struct {
+    char** paths;
+    int count;
+    JobRange* ranges;
+    int workers;
+    const IssOptions* options;
+    BatchFormat format;
+    pthread_mutex_t output_lock;
+    atomic_int failures;
+} Batch;
+
+typedef struct {
+    Batch* batch;
+    int id;
+} Worker;
+
+static uint64_t pack_range(uint32_t next, uint32_t end) {
+    return ((uint64_t)next << 32) | end;
+}
+
+// take the next job of our own range, -1 when it is empty
+static int take_own(JobRange* own) {
+    uint64_t range = atomic_load(&own->range);
+    for (;;) {
+        uint32_t next = (uint32_t)(range >> 32);
+        uint32_t end = (uint32_t)range;
+        if (next >= end) {
+            return -1;
+        }
+        if (atomic_compare_exchange_weak(&own->range, &range, pack_range(next + 1, end))) {
+            return (int)next;
+        }
+    }
+}
+
+// move the back half of the largest other range into our empty one
+static int steal(Batch* batch, int self) {
+    for (;;) {
+        int victim = -1;
+        uint32_t best = 0;
+        for (int w = 0; w < batch->workers; w++) {
+            uint64_t range = atomic_load(&batch->ranges[w].range);
+            uint32_t left = (uint32_t)range - (uint32_t)(range >> 32);
+            if (w != self && (uint32_t)(range >> 32) < (uint32_t)range && left > best) {
+                best = left;
+                victim = w;
+            }
+        }
+        if (victim < 0) {
+            return 0;
+        }
+        uint64_t range = atomic_load(&batch->ranges[victim].range);
+        uint32_t next = (uint32_t)(range >> 32);
+        uint32_t end = (uint32_t)range;
+        if (next >= end) {
+            continue;
+        }
+        uint32_t split = end - (end - next + 1) / 2;
+        if (atomic_compare_exchange_strong(&batch->ranges[victim].range, &range, pack_range(next, split))) {
+            atomic_store(&batch->ranges[self].range, pack_range(split, end));
+            return 1;
+        }
+    }
+}
+
+static double elapsed_us(const struct timespec* start, const struct timespec* stop) {
+    return (double)(stop->tv_sec - start->tv_sec) * 1e6 + (double)(stop->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static void print_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void print_row(Batch* batch, const char* path, const IssStats* stats, double wall_us, int ok) {
+    const char* status = !ok ? "error" : stats->budget_exhausted ? "budget" : "ok";
+    pthread_mutex_lock(&batch->output_lock);
+    if (batch->format == BATCH_FORMAT_JSON) {
+        printf("{\"file\":");
+        print_json_string(stdout, path);
+        printf(",\"executed_instructions\":%lld,\"clock_cycles\":%lld,\"local_memory_hits\":%lld,"
+               "\"ld_st_instructions\":%lld,\"wall_us\":%.1f,\"status\":\"%s\"}\n",
+               stats->executed_instructions, stats->clock_cycles, stats->local_memory_hits,
+               stats->memory_instructions, wall_us, status);
+    } else {
+        // quote the path only when it would break the row
+        if (strpbrk(path, ",\"\n")) {
+            putchar('"');
+            for (const char* c = path; *c; c++) {
+                if (*c == '"') {
+                    putchar('"');
+                }
+                putchar(*c);
+            }
+            putchar('"');
+        } else {
+            fputs(path, stdout);
+        }
+        printf(",%lld,%lld,%lld,%lld,%.1f,%s\n",
+               stats->executed_instructions, stats->clock_cycles, stats->local_memory_hits,
+               stats->memory_instructions, wall_us, status);
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&batch->output_lock);
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    Batch* batch = worker->batch;
+    IssContext* ctx = iss_create(batch->options);
+    if (!ctx) {
+        atomic_fetch_add(&batch->failures, 1);
+        return NULL;
+    }
+
+    for (;;) {
+        int job = take_own(&batch->ranges[worker->id]);
+        if (job < 0) {
+            if (!steal(batch, worker->id)) {
+                break;
+            }
+            continue;
+        }
+
+        IssStats stats;
+        memset(&stats, 0, sizeof(stats));
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int ok = (iss_load_file(ctx, batch->paths[job]) == 0);
+        if (ok) {
+            iss_run(ctx);
+            iss_get_stats(ctx, &stats);
+        } else {
+            atomic_fetch_add(&batch->failures, 1);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        print_row(batch, batch->paths[job], &stats, elapsed_us(&start, &stop), ok);
+    }
+
+    iss_destroy(ctx);
+    return NULL;
+}
+
+static int has_suffix(const char* name, const char* suffix) {
+    size_t n = strlen(name);
+    size_t s = strlen(suffix);
+    return n > s && strcmp(name + n - s, suffix) == 0;
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// append one path to a growing list, returns -1 when out of memory
+static int add_path(char*** paths, int* count, int* capacity, char* path) {
+    if (!path) {
+        return -1;
+    }
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 256;
+        char** resized = realloc(*paths, (size_t)grown * sizeof(char*));
+        if (!resized) {
+            free(path);
+            return -1;
+        }
+        *paths = resized;
+        *capacity = grown;
+    }
+    (*paths)[(*count)++] = path;
+    return 0;
+}
+
+// directory: its *.assembly, *.asm and *.issbin files sorted by name, otherwise a list
+static int collect_paths(const char* path, char*** paths, int* count) {
+    int capacity = 0;
+    struct stat info;
+    *paths = NULL;
+    *count = 0;
+
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return -1;
+    }
+    if (S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(path);
+        if (!dir) {
+            fprintf(stderr, "Error: Could not open directory %s\n", path);
+            return -1;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (!has_suffix(entry->d_name, ".assembly") && !has_suffix(entry->d_name, ".asm") &&
+                !has_suffix(entry->d_name, ".issbin")) {
+                continue;
+            }
+            size_t length = strlen(path) + strlen(entry->d_name) + 2;
+            char* full = malloc(length);
+            if (full) {
+                snprintf(full, length, "%s/%s", path, entry->d_name);
+            }
+            if (add_path(paths, count, &capacity, full) != 0) {
+                closedir(dir);
+                fprintf(stderr, "Memory allocation failed\n");
+                return -1;
+            }
+        }
+        closedir(dir);
+        qsort(*paths, (size_t)*count, sizeof(char*), compare_paths);
+        return 0;
+    }
+
+    FILE* list = fopen(path, "r");
+    if (!list) {
+        fprintf(stderr, "Error: Could not open file %s\n", path);
+        return -1;
+    }
+    char* line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &size, list)) != -1) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (add_path(paths, count, &capacity, strdup(line)) != 0) {
+            free(line);
+            fclose(list);
+            fprintf(stderr, "Memory allocation failed\n");
+            return -1;
+        }
+    }
+    free(line);
+    fclose(list);
+    return 0;
+}
+
+int run_batch(const char* path, const IssOptions* options, int jobs, BatchFormat format) {
+    Batch batch;
+    memset(&batch, 0, sizeof(batch));
+    if (collect_paths(path, &batch.paths, &batch.count) != 0) {
+        for (int i = 0; i < batch.count; i++) {
+            free(batch.paths[i]);
+        }
+        free(batch.paths);
+        return -1;
+    }
+
+    if (jobs <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cores > 0 ? (int)cores : 1;
+    }
+    if (jobs > batch.count) {
+        jobs = batch.count > 0 ? batch.count : 1;
+    }
+    batch.workers = jobs;
+    batch.options = options;
+    batch.format = format;
+    atomic_init(&batch.failures, 0);
+    pthread_mutex_init(&batch.output_lock, NULL);
+
+    // even initial split, stealing evens out whatever the programs cost
+    batch.ranges = malloc((size_t)jobs * sizeof(JobRange));
+    pthread_t* threads = malloc((size_t)jobs * sizeof(pthread_t));
+    Worker* workers = malloc((size_t)jobs * sizeof(Worker));
+    if (!batch.ranges || !threads || !workers) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int w = 0; w < jobs; w++) {
+        uint32_t begin = (uint32_t)((int64_t)batch.count * w / jobs);
+        uint32_t end = (uint32_t)((int64_t)batch.count * (w + 1) / jobs);
+        atomic_init(&batch.ranges[w].range, pack_range(begin, end));
+        workers[w].batch = &batch;
+        workers[w].id = w;
+    }
+
+    if (format == BATCH_FORMAT_CSV) {
+        printf("file,executed_instructions,clock_cycles,local_memory_hits,ld_st_instructions,wall_us,status\n");
+    }
+    int started = 0;
+    for (int w = 0; w < jobs; w++) {
+        if (pthread_create(&threads[w], NULL, worker_main, &workers[w]) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        // no threads available, this one steals every range in turn
+        worker_main(&workers[0]);
+    }
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    int failures = atomic_load(&batch.failures);
+    pthread_mutex_destroy(&batch.output_lock);
+    for (int i = 0; i < batch.count; i++) {
+        free(batch.paths[i]);
+    }
+    free(batch.paths);
+    free(batch.ranges);
+    free(threads);
+    free(workers);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "iss.h"
+
+// Batch mode: simulate every program of a corpus on a pool of worker
+// threads, one IssContext per worker, and stream one result row per program.
+
+typedef enum {
+    BATCH_FORMAT_CSV = 0,
+    BATCH_FORMAT_JSON     // JSON lines, one object per program
+} BatchFormat;
+
+// path is a directory (every *.assembly / *.asm / *.issbin file in it) or a text file
+// listing one program path per line. jobs <= 0 means one worker per core.
+// returns 0 if every program ran, 1 if some failed to load, -1 on a bad path
+int run_batch(const char* path, const IssOptions* options, int jobs, BatchFormat format);
+
+#endif
@@ -0,0 +1,348 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include "iss.h"
+#include "source.h"
+
+// Benchmark harness (make bench). Times the load, decode and execute phases
+// of each program in-process with the monotonic clock, for every run-time
+// variant of the engine this binary was built with, so no fork/exec or
+// shell overhead is measured. A sample repeats its phase until it lasts
+// BENCH_MIN_SAMPLE_NS, well above the clock resolution. Samples are taken
+// in rounds that double in size, until a round moves the median by less
+// than the tolerance or the time limit is reached. Every measurement is
+// one line with the same columns in a fixed order, so runs diff cleanly
+// across commits.
+//
+//   load      map or read the file (source_open)
+//   decode    parse and analyze the text already in memory (iss_load_memory),
+//             fusion, loop detection and JIT translation included
+//   execute   iss_reset and iss_run
+//
+// With --startup the in-process phases are skipped, and each sample instead
+// spawns the given simulator binaries on the program and waits for them to
+// exit, output discarded, so startup and teardown are what gets compared:
+//
+//   startup   posix_spawn to waitpid of one `BINARY <program>` run
+
+#if defined(JIT_BACKEND)
+#define BENCH_ENGINE "jit"
+#elif defined(THREADED_DISPATCH)
+#define BENCH_ENGINE "threaded"
+#else
+#define BENCH_ENGINE "switch"
+#endif
+
+#define BENCH_MIN_SAMPLE_NS 100000.0
+#define BENCH_MAX_REPS (1L << 20)
+#define BENCH_FIRST_ROUND 10
+#define BENCH_MAX_SAMPLES 20480
+#define BENCH_MAX_BINARIES 8
+
+extern char** environ;
+
+typedef struct {
+    const char* name;
+    int fusion;
+    int fast_forward;
+} BenchVariant;
+
+static const BenchVariant bench_variants[] = {
+#ifdef JIT_BACKEND
+    {"jit", 0, 0},
+#else
+    {"fused+ff", 1, 1},
+    {"fused", 1, 0},
+    {"plain+ff", 0, 1},
+    {"plain", 0, 0},
+#endif
+};
+
+typedef struct {
+    double tolerance;           // relative change of the median that counts as settled
+    double max_seconds;         // per measurement
+    long long max_instructions; // run budget, so programs that never halt still finish
+} BenchConfig;
+
+// what the phases work on
+typedef struct {
+    const char* path;
+    SourceText text;
+    IssContext* ctx;
+    char** argv;        // startup: the command line to spawn
+    posix_spawn_file_actions_t* actions;
+} BenchJob;
+
+typedef struct {
+    int samples;
+    long reps;          // phase runs per sample
+    double median_ns;   // per phase run
+    double p99_ns;
+    int stable;
+} BenchResult;
+
+typedef int (*BenchPhase)(BenchJob* job);
+
+static double bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static int phase_load(BenchJob* job) {
+    SourceText text;
+    if (source_open(&text, job->path) != 0) {
+        return -1;
+    }
+    source_close(&text);
+    return 0;
+}
+
+static int phase_decode(BenchJob* job) {
+    return iss_load_memory(job->ctx, job->text.data, job->text.size);
+}
+
+static int phase_execute(BenchJob* job) {
+    iss_reset(job->ctx);
+    iss_run(job->ctx);
+    return 0;
+}
+
+static int phase_startup(BenchJob* job) {
+    pid_t pid;
+    int status;
+    if (posix_spawn(&pid, job->argv[0], job->actions, NULL, job->argv, environ) != 0 ||
+        waitpid(pid, &status, 0) != pid) {
+        return -1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank over sorted samples
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)(p * count + 0.999999);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// one sample: mean time of reps back-to-back runs of phase
+static double time_sample(BenchPhase phase, BenchJob* job, long reps) {
+    double start = bench_now_ns();
+    for (long r = 0; r < reps; r++) {
+        phase(job);
+    }
+    return (bench_now_ns() - start) / (double)reps;
+}
+
+// samples and sorted hold BENCH_MAX_SAMPLES each
+static int measure(BenchPhase phase, BenchJob* job, const BenchConfig* config, double* samples,
+                   double* sorted, BenchResult* result) {
+    // the first run warms caches and checks the phase works at all
+    if (phase(job) != 0) {
+        return -1;
+    }
+    long reps = 1;
+    while (reps < BENCH_MAX_REPS && time_sample(phase, job, reps) * (double)reps < BENCH_MIN_SAMPLE_NS) {
+        reps *= 2;
+    }
+
+    double deadline = bench_now_ns() + config->max_seconds * 1e9;
+    double previous = -1.0;
+    int count = 0;
+    int target = BENCH_FIRST_ROUND;
+    memset(result, 0, sizeof(*result));
+    for (;;) {
+        int timed_out = 0;
+        while (count < target && !timed_out) {
+            samples[count++] = time_sample(phase, job, reps);
+            timed_out = bench_now_ns() >= deadline;
+        }
+        memcpy(sorted, samples, (size_t)count * sizeof(double));
+        qsort(sorted, (size_t)count, sizeof(double), compare_double);
+        double median = percentile(sorted, count, 0.5);
+        double change = median - previous;
+        if (previous > 0 && (change < 0 ? -change : change) <= config->tolerance * previous) {
+            result->stable = 1;
+            break;
+        }
+        previous = median;
+        if (timed_out || target * 2 > BENCH_MAX_SAMPLES) {
+            break;
+        }
+        target *= 2;
+    }
+    result->samples = count;
+    result->reps = reps;
+    result->median_ns = percentile(sorted, count, 0.5);
+    result->p99_ns = percentile(sorted, count, 0.99);
+    return 0;
+}
+
+static void print_header(void) {
+    printf("# %-8s %-9s %-22s %-8s %8s %8s %14s %14s %10s %s\n", "engine", "variant", "program", "phase",
+           "samples", "reps", "median_ns", "p99_ns", "Minst/s", "stability");
+}
+
+// instructions < 0 leaves the rate column empty
+static void print_result(const char* engine, const char* variant, const char* program, const char* phase,
+                         const BenchResult* result, long long instructions) {
+    char rate[32] = "-";
+    if (instructions >= 0 && result->median_ns > 0) {
+        snprintf(rate, sizeof(rate), "%.1f", (double)instructions / result->median_ns * 1e3);
+    }
+    printf("  %-8s %-9s %-22s %-8s %8d %8ld %14.0f %14.0f %10s %s\n", engine, variant, program, phase,
+           result->samples, result->reps, result->median_ns, result->p99_ns, rate,
+           result->stable ? "stable" : "unsettled");
+    fflush(stdout);
+}
+
+static const char* base_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// every phase of one program, returns -1 if it could not be loaded
+static int bench_program(const char* path, const BenchConfig* config, double* samples, double* sorted) {
+    BenchJob job;
+    BenchResult result;
+    memset(&job, 0, sizeof(job));
+    job.path = path;
+    const char* program = base_name(path);
+
+    if (measure(phase_load, &job, config, samples, sorted, &result) != 0) {
+        return -1;
+    }
+    print_result(BENCH_ENGINE, "-", program, "load", &result, -1);
+    if (source_open(&job.text, path) != 0) {
+        return -1;
+    }
+
+    int status = 0;
+    for (size_t v = 0; v < sizeof(bench_variants) / sizeof(bench_variants[0]) && status == 0; v++) {
+        IssOptions options;
+        iss_options_default(&options);
+        options.fusion = bench_variants[v].fusion;
+        options.fast_forward = bench_variants[v].fast_forward;
+        options.max_instructions = config->max_instructions;
+        job.ctx = iss_create(&options);
+        if (!job.ctx || measure(phase_decode, &job, config, samples, sorted, &result) != 0) {
+            status = -1;
+        } else {
+            print_result(BENCH_ENGINE, bench_variants[v].name, program, "decode", &result, -1);
+            measure(phase_execute, &job, config, samples, sorted, &result);
+            IssStats stats;
+            iss_get_stats(job.ctx, &stats);
+            print_result(BENCH_ENGINE, bench_variants[v].name, program, "execute", &result,
+                         stats.executed_instructions);
+        }
+        iss_destroy(job.ctx);
+    }
+    source_close(&job.text);
+    return status;
+}
+
+// one startup measurement per binary, returns -1 if one failed to run the program
+static int bench_startup(const char* path, const BenchConfig* config, char** binaries, int count,
+                         double* samples, double* sorted) {
+    char budget[32];
+    snprintf(budget, sizeof(budget), "%lld", config->max_instructions);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+    int status = 0;
+    for (int b = 0; b < count && status == 0; b++) {
+        char* argv[] = {binaries[b], "--max-instructions", budget, (char*)path, NULL};
+        BenchJob job;
+        BenchResult result;
+        memset(&job, 0, sizeof(job));
+        job.path = path;
+        job.argv = argv;
+        job.actions = &actions;
+        if (measure(phase_startup, &job, config, samples, sorted, &result) != 0) {
+            fprintf(stderr, "Error: %s failed on %s\n", binaries[b], path);
+            status = -1;
+        } else {
+            print_result("process", base_name(binaries[b]), base_name(path), "startup", &result, -1);
+        }
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return status;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <assembly_file>...\n", program);
+    fprintf(stderr, "  --tolerance F          median change that counts as settled (default 0.01)\n");
+    fprintf(stderr, "  --max-time S           time limit per measurement in seconds (default 1)\n");
+    fprintf(stderr, "  --max-instructions N   run budget of every execution (default 1000000, 0 unlimited)\n");
+    fprintf(stderr, "  --startup BINARY       time whole runs of a simulator binary instead (repeatable)\n");
+    fprintf(stderr, "  --no-header            omit the column header\n");
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config = {0.01, 1.0, 1000000};
+    int header = 1;
+    char* binaries[BENCH_MAX_BINARIES];
+    int binary_count = 0;
+    int first_program = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            config.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-time") == 0 && i + 1 < argc) {
+            config.max_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-instructions") == 0 && i + 1 < argc) {
+            config.max_instructions = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--startup") == 0 && i + 1 < argc && binary_count < BENCH_MAX_BINARIES) {
+            binaries[binary_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--no-header") == 0) {
+            header = 0;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            first_program = i;
+            break;
+        }
+    }
+    if (first_program == argc || config.tolerance <= 0 || config.max_seconds <= 0 || config.max_instructions < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    double* samples = malloc(BENCH_MAX_SAMPLES * sizeof(double));
+    double* sorted = malloc(BENCH_MAX_SAMPLES * sizeof(double));
+    if (!samples || !sorted) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(samples);
+        free(sorted);
+        return 1;
+    }
+    if (header) {
+        print_header();
+    }
+    int failed = 0;
+    for (int i = first_program; i < argc; i++) {
+        int status = binary_count > 0 ? bench_startup(argv[i], &config, binaries, binary_count, samples, sorted)
+                                      : bench_program(argv[i], &config, samples, sorted);
+        if (status != 0) {
+            fprintf(stderr, "Error: could not benchmark %s\n", argv[i]);
+            failed = 1;
+        }
+    }
+    free(samples);
+    free(sorted);
+    return failed;
+}
@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+
+static const char* const policy_names[] = {
+    [CACHE_POLICY_LRU] = "LRU",
+    [CACHE_POLICY_FIFO] = "FIFO",
+    [CACHE_POLICY_RANDOM] = "random",
+    [CACHE_POLICY_PLRU] = "PLRU"
+};
+
+// log2 of a power of two, -1 otherwise
+static int log2_exact(uint32_t value) {
+    if (value == 0 || (value & (value - 1)) != 0) {
+        return -1;
+    }
+    int bits = 0;
+    while ((1u << bits) != value) {
+        bits++;
+    }
+    return bits;
+}
+
+void cache_config_default(CacheConfig* config) {
+    config->size = 256;
+    config->line_size = 1;
+    config->associativity = 1;
+    config->policy = CACHE_POLICY_LRU;
+}
+
+int cache_parse_option(CacheConfig* config, const char* name, const char* value) {
+    uint32_t* field = NULL;
+
+    if (strcmp(name, "--cache-size") == 0) {
+        field = &config->size;
+    } else if (strcmp(name, "--line-size") == 0) {
+        field = &config->line_size;
+    } else if (strcmp(name, "--assoc") == 0) {
+        field = &config->associativity;
+    } else if (strcmp(name, "--policy") == 0) {
+        if (!value) {
+            return -1;
+        }
+        if (strcmp(value, "lru") == 0) {
+            config->policy = CACHE_POLICY_LRU;
+        } else if (strcmp(value, "fifo") == 0) {
+            config->policy = CACHE_POLICY_FIFO;
+        } else if (strcmp(value, "random") == 0) {
+            config->policy = CACHE_POLICY_RANDOM;
+        } else if (strcmp(value, "plru") == 0) {
+            config->policy = CACHE_POLICY_PLRU;
+        } else {
+            fprintf(stderr, "Error: unknown cache policy %s (lru, fifo, random, plru)\n", value);
+            return -1;
+        }
+        return 1;
+    } else {
+        return 0;
+    }
+
+    if (!value) {
+        return -1;
+    }
+    char* end = NULL;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed == 0 || parsed > UINT32_MAX) {
+        fprintf(stderr, "Error: invalid value %s for %s\n", value, name);
+        return -1;
+    }
+    *field = (uint32_t)parsed;
+    return 1;
+}
+
+int cache_model_init(CacheModel* cache, const CacheConfig* config) {
+    memset(cache, 0, sizeof(*cache));
+    cache->config = *config;
+
+    int offset_bits = log2_exact(config->line_size);
+    int way_bits = log2_exact(config->associativity);
+    int size_bits = log2_exact(config->size);
+    if (offset_bits < 0 || way_bits < 0 || size_bits < 0) {
+        fprintf(stderr, "Error: cache size, line size and associativity must be powers of two\n");
+        return -1;
+    }
+    if (size_bits < offset_bits + way_bits) {
+        fprintf(stderr, "Error: cache of %u B cannot hold %u ways of %u B lines\n",
+                config->size, config->associativity, config->line_size);
+        return -1;
+    }
+    if (config->associativity > UINT16_MAX) {
+        fprintf(stderr, "Error: associativity %u too large\n", config->associativity);
+        return -1;
+    }
+
+    cache->ways = config->associativity;
+    cache->offset_bits = (uint32_t)offset_bits;
+    cache->set_bits = (uint32_t)(size_bits - offset_bits - way_bits);
+    cache->num_sets = 1u << cache->set_bits;
+    cache->set_mask = cache->num_sets - 1;
+
+    size_t lines = (size_t)cache->num_sets * cache->ways;
+    cache->tags = calloc(lines, sizeof(uint32_t));
+    cache->stamps = calloc(lines, sizeof(uint64_t));
+    cache->plru = calloc(lines, sizeof(uint8_t));
+    cache->fill = calloc(cache->num_sets, sizeof(uint16_t));
+    cache->set_conflicts = calloc(cache->num_sets, sizeof(uint64_t));
+    if (!cache->tags || !cache->stamps || !cache->plru || !cache->fill || !cache->set_conflicts) {
+        fprintf(stderr, "Memory allocation failed\n");
+        cache_model_free(cache);
+        return -1;
+    }
+
+    cache_model_reset(cache);
+    return 0;
+}
+
+void cache_model_reset(CacheModel* cache) {
+    size_t lines = (size_t)cache->num_sets * cache->ways;
+    // tags and stamps are only read below fill, clearing fill is enough
+    memset(cache->fill, 0, cache->num_sets * sizeof(uint16_t));
+    memset(cache->plru, 0, lines * sizeof(uint8_t));
+    memset(cache->set_conflicts, 0, cache->num_sets * sizeof(uint64_t));
+    cache->clock = 0;
+    cache->rng_state = 0x9E3779B9u;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+}
+
+void cache_model_free(CacheModel* cache) {
+    free(cache->tags);
+    free(cache->fill);
+    free(cache->stamps);
+    free(cache->plru);
+    free(cache->set_conflicts);
+    cache->tags = NULL;
+    cache->fill = NULL;
+    cache->stamps = NULL;
+    cache->plru = NULL;
+    cache->set_conflicts = NULL;
+}
+
+// fill, then the per-line arrays, per-set conflicts and the scalars
+#define CACHE_STATE_SCALARS 5
+
+size_t cache_model_state_size(const CacheModel* cache) {
+    size_t lines = (size_t)cache->num_sets * cache->ways;
+    return cache->num_sets * (sizeof(uint16_t) + sizeof(uint64_t)) +
+           lines * (sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint8_t)) +
+           CACHE_STATE_SCALARS * sizeof(uint64_t);
+}
+
+void cache_model_save_state(const CacheModel* cache, uint8_t* out) {
+    size_t lines = (size_t)cache->num_sets * cache->ways;
+    uint64_t scalars[CACHE_STATE_SCALARS] = {
+        cache->clock, cache->rng_state, cache->hits, cache->misses, cache->evictions
+    };
+    memcpy(out, cache->fill, cache->num_sets * sizeof(uint16_t));
+    out += cache->num_sets * sizeof(uint16_t);
+    memcpy(out, cache->tags, lines * sizeof(uint32_t));
+    out += lines * sizeof(uint32_t);
+    memcpy(out, cache->stamps, lines * sizeof(uint64_t));
+    out += lines * sizeof(uint64_t);
+    memcpy(out, cache->plru, lines * sizeof(uint8_t));
+    out += lines * sizeof(uint8_t);
+    memcpy(out, cache->set_conflicts, cache->num_sets * sizeof(uint64_t));
+    out += cache->num_sets * sizeof(uint64_t);
+    memcpy(out, scalars, sizeof(scalars));
+}
+
+void cache_model_load_state(CacheModel* cache, const uint8_t* in) {
+    size_t lines = (size_t)cache->num_sets * cache->ways;
+    uint64_t scalars[CACHE_STATE_SCALARS];
+    memcpy(cache->fill, in, cache->num_sets * sizeof(uint16_t));
+    in += cache->num_sets * sizeof(uint16_t);
+    memcpy(cache->tags, in, lines * sizeof(uint32_t));
+    in += lines * sizeof(uint32_t);
+    memcpy(cache->stamps, in, lines * sizeof(uint64_t));
+    in += lines * sizeof(uint64_t);
+    memcpy(cache->plru, in, lines * sizeof(uint8_t));
+    in += lines * sizeof(uint8_t);
+    memcpy(cache->set_conflicts, in, cache->num_sets * sizeof(uint64_t));
+    in += cache->num_sets * sizeof(uint64_t);
+    memcpy(scalars, in, sizeof(scalars));
+    cache->clock = scalars[0];
+    cache->rng_state = (uint32_t)scalars[1];
+    cache->hits = scalars[2];
+    cache->misses = scalars[3];
+    cache->evictions = scalars[4];
+}
+
+// point every tree node on the path to way away from it
+void cache_model_touch_plru(CacheModel* cache, uint32_t set, uint32_t way) {
+    uint8_t* nodes = cache->plru + (size_t)set * cache->ways;
+    uint32_t node = way + cache->ways;
+    while (node > 1) {
+        uint32_t parent = node >> 1;
+        nodes[parent] = (uint8_t)((node & 1) ? 0 : 1);
+        node = parent;
+    }
+}
+
+uint32_t cache_model_victim(CacheModel* cache, uint32_t set) {
+    uint32_t base = set * cache->ways;
+    uint32_t victim = 0;
+
+    cache->evictions++;
+    cache->set_conflicts[set]++;
+
+    switch (cache->config.policy) {
+        case CACHE_POLICY_LRU:
+        case CACHE_POLICY_FIFO:
+            // oldest stamp, last use for LRU and insertion for FIFO
+            for (uint32_t way = 1; way < cache->ways; way++) {
+                if (cache->stamps[base + way] < cache->stamps[base + victim]) {
+                    victim = way;
+                }
+            }
+            break;
+        case CACHE_POLICY_RANDOM:
+            cache->rng_state ^= cache->rng_state << 13;
+            cache->rng_state ^= cache->rng_state >> 17;
+            cache->rng_state ^= cache->rng_state << 5;
+            victim = cache->rng_state & (cache->ways - 1);
+            break;
+        case CACHE_POLICY_PLRU:
+            {
+                const uint8_t* nodes = cache->plru + base;
+                uint32_t node = 1;
+                while (node < cache->ways) {
+                    node = (node << 1) | nodes[node];
+                }
+                victim = node - cache->ways;
+            }
+            break;
+    }
+    return victim;
+}
+
+void cache_model_print_stats(const CacheModel* cache, FILE* out) {
+    fprintf(out, "Cache configuration: %u B, %u B lines, %u-way, %u sets, %s\n",
+            cache->config.size, cache->config.line_size, cache->ways,
+            cache->num_sets, policy_names[cache->config.policy]);
+    fprintf(out, "Cache hits: %llu\n", (unsigned long long)cache->hits);
+    fprintf(out, "Cache misses: %llu\n", (unsigned long long)cache->misses);
+    fprintf(out, "Cache evictions: %llu\n", (unsigned long long)cache->evictions);
+    fprintf(out, "Per-set conflicts (set: evictions):");
+    int any = 0;
+    for (uint32_t set = 0; set < cache->num_sets; set++) {
+        if (cache->set_conflicts[set]) {
+            fprintf(out, " %u:%llu", set, (unsigned long long)cache->set_conflicts[set]);
+            any = 1;
+        }
+    }
+    fprintf(out, any ? "\n" : " none\n");
+}
@@ -0,0 +1,102 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Configurable set-associative cache model shared by both simulators.
+// The default geometry (256 B, 1 B lines, direct mapped) gives every 8-bit
+// address its own line, which is exactly the old first-touch-miss model.
+
+typedef enum {
+    CACHE_POLICY_LRU = 0,
+    CACHE_POLICY_FIFO,
+    CACHE_POLICY_RANDOM,
+    CACHE_POLICY_PLRU
+} CachePolicy;
+
+typedef struct {
+    uint32_t size;          // total capacity in bytes
+    uint32_t line_size;     // bytes per line
+    uint32_t associativity; // ways per set
+    CachePolicy policy;
+} CacheConfig;
+
+typedef struct {
+    CacheConfig config;
+    uint32_t ways;
+    uint32_t num_sets;
+    uint32_t offset_bits;   // log2(line_size)
+    uint32_t set_bits;      // log2(num_sets)
+    uint32_t set_mask;
+    uint32_t* tags;         // packed [set * ways + way], valid ways are [0, fill)
+    uint16_t* fill;         // valid lines per set, sets fill in way order
+    uint64_t* stamps;       // LRU: last use, FIFO: insertion time
+    uint8_t* plru;          // tree bits per set, nodes 1..ways-1
+    uint64_t clock;
+    uint32_t rng_state;     // xorshift32, fixed seed so runs are repeatable
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t* set_conflicts; // evictions per set
+} CacheModel;
+
+// fill in the default configuration (reproduces the first-touch model)
+void cache_config_default(CacheConfig* config);
+
+// parse one "--name value" command-line option into config
+// returns 1 if the option was a cache option, 0 if not, -1 on a bad value
+int cache_parse_option(CacheConfig* config, const char* name, const char* value);
+
+// returns 0 on success, -1 on an invalid geometry (message on stderr)
+int cache_model_init(CacheModel* cache, const CacheConfig* config);
+void cache_model_reset(CacheModel* cache);
+void cache_model_free(CacheModel* cache);
+void cache_model_print_stats(const CacheModel* cache, FILE* out);
+
+// checkpoints: the contents and replacement state as one flat blob, which
+// only loads into a model of the same configuration
+size_t cache_model_state_size(const CacheModel* cache);
+void cache_model_save_state(const CacheModel* cache, uint8_t* out);
+void cache_model_load_state(CacheModel* cache, const uint8_t* in);
+
+// slow path: pick a victim way in a full set and account the eviction
+uint32_t cache_model_victim(CacheModel* cache, uint32_t set);
+void cache_model_touch_plru(CacheModel* cache, uint32_t set, uint32_t way);
+
+// access one address, returns 1 on hit and 0 on miss (line is filled)
+static inline int cache_model_access(CacheModel* cache, uint32_t address) {
+    uint32_t line = address >> cache->offset_bits;
+    uint32_t set = line & cache->set_mask;
+    uint32_t tag = (cache->set_bits < 32) ? (line >> cache->set_bits) : 0;
+    uint32_t base = set * cache->ways;
+    uint32_t* tags = cache->tags + base;
+    uint32_t fill = cache->fill[set];
+
+    for (uint32_t way = 0; way < fill; way++) {
+        if (tags[way] == tag) {
+            cache->hits++;
+            if (cache->config.policy == CACHE_POLICY_LRU) {
+                cache->stamps[base + way] = ++cache->clock;
+            } else if (cache->config.policy == CACHE_POLICY_PLRU) {
+                cache_model_touch_plru(cache, set, way);
+            }
+            return 1;
+        }
+    }
+
+    cache->misses++;
+    uint32_t way = (fill < cache->ways) ? fill : cache_model_victim(cache, set);
+    if (fill < cache->ways) {
+        cache->fill[set] = (uint16_t)(fill + 1);
+    }
+    tags[way] = tag;
+    cache->stamps[base + way] = ++cache->clock;
+    if (cache->config.policy == CACHE_POLICY_PLRU) {
+        cache_model_touch_plru(cache, set, way);
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+// Synthetic workload generator (make gen). Emits valid myISS programs of a
+// given size as a run of loop-nest kernels, deterministically from a seed,
+// so a suite regenerates byte for byte anywhere. Each kernel is
+//
+//   MOV R5, base                  address stream of the kernel
+//   MOV Rk, trips                 per level k = 1..depth, counting down
+//   head_k: ...                   the next level, innermost: the body
+//           ADD Rk, -1
+//           CMP Rk, R6            R6 stays 0
+//           JE exit_k
+//           JMP head_k
+//   exit_k:
+//
+// The body mixes LD R4, [R5] / ST [R5], R4, each followed by ADD R5, 1,
+// with ALU work on R4. Innermost loops are counted loops the fast-forward
+// can solve, unless a reuse window is set: then the body compares R5
+// against the end of the window and jumps to a reset block. Every loop
+// counts down from 1..255 to 0, so every program halts.
+
+#define GEN_MAX_DEPTH 3    // R1-R3 count, R4 data, R5 address, R6 zero
+
+typedef struct {
+    long long lines;       // program size
+    int depth;             // loop nesting of every kernel, 0 for straight-line code
+    int min_trips;         // per loop, uniform in [min_trips, max_trips]
+    int max_trips;
+    int body;              // operations in the innermost body
+    double memory_ratio;   // fraction of body operations that are LD/ST
+    double store_ratio;    // fraction of LD/ST that are stores
+    int reuse;             // distinct addresses a kernel's stream cycles through, 256 = no window
+    int explicit_lines;    // "N<TAB>instruction" instead of bare instructions
+    int first_line;        // line number of the first record
+    uint64_t seed;
+} GenConfig;
+
+typedef struct {
+    FILE* out;
+    const GenConfig* config;
+    long long written;     // records so far, the next one is first_line + written
+    uint64_t state;        // splitmix64
+} Generator;
+
+static uint64_t gen_next(Generator* g) {
+    uint64_t z = (g->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// uniform in [low, high]
+static int gen_range(Generator* g, int low, int high) {
+    return low + (int)(gen_next(g) % (uint64_t)(high - low + 1));
+}
+
+static int gen_chance(Generator* g, double p) {
+    return (double)(gen_next(g) >> 11) * (1.0 / 9007199254740992.0) < p;
+}
+
+static long long gen_line(const Generator* g, long long record) {
+    return g->config->first_line + record;
+}
+
+static void emit(Generator* g, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void emit(Generator* g, const char* format, ...) {
+    va_list args;
+    if (g->config->explicit_lines) {
+        fprintf(g->out, "%lld\t", gen_line(g, g->written));
+    }
+    va_start(args, format);
+    vfprintf(g->out, format, args);
+    va_end(args);
+    fputc('\n', g->out);
+    g->written++;
+}
+
+// ALU work on the data register, reading the counters too
+static void emit_alu(Generator* g) {
+    int counter = g->config->depth > 0 ? gen_range(g, 1, g->config->depth) : 0;
+    if (counter > 0 && gen_chance(g, 0.5)) {
+        emit(g, "ADD R4, R%d", counter);
+    } else {
+        emit(g, "ADD R4, %d", gen_range(g, -8, 8));
+    }
+}
+
+static void emit_memory(Generator* g) {
+    if (gen_chance(g, g->config->store_ratio)) {
+        emit(g, "ST [R5], R4");
+    } else {
+        emit(g, "LD R4, [R5]");
+    }
+    emit(g, "ADD R5, 1");
+}
+
+// records of one kernel besides its body operations
+static long long kernel_overhead(const GenConfig* config, int windowed) {
+    return 1 + 5LL * config->depth + (windowed ? 5 : 0);
+}
+
+// the body's operations are drawn up front so the kernel size is known
+// before any jump target is written
+typedef struct {
+    int count;
+    int memory_ops;
+    uint8_t* is_memory;
+} GenBody;
+
+static long long body_records(const GenBody* body) {
+    return body->count + body->memory_ops;
+}
+
+static void draw_body(Generator* g, GenBody* body, int count) {
+    body->count = count;
+    body->memory_ops = 0;
+    for (int i = 0; i < count; i++) {
+        body->is_memory[i] = (uint8_t)gen_chance(g, g->config->memory_ratio);
+        body->memory_ops += body->is_memory[i];
+    }
+}
+
+// the reuse window, rounded up to whole iterations of the innermost body so
+// the end check once per iteration lands on it exactly, 0 for none
+static int window_size(const GenConfig* config, const GenBody* body) {
+    if (config->reuse >= 256 || body->memory_ops == 0 || config->depth == 0) {
+        return 0;
+    }
+    int size = (config->reuse + body->memory_ops - 1) / body->memory_ops * body->memory_ops;
+    return size < 256 ? size : 0;
+}
+
+static void emit_body(Generator* g, const GenBody* body) {
+    for (int i = 0; i < body->count; i++) {
+        if (body->is_memory[i]) {
+            emit_memory(g);
+        } else {
+            emit_alu(g);
+        }
+    }
+}
+
+// records of levels level..depth, from the counter's MOV to the exit
+static long long level_records(const GenConfig* config, int level, const GenBody* body, int window) {
+    return 5LL * (config->depth - level + 1) + body_records(body) + (window ? 5 : 0);
+}
+
+// levels level..depth, the innermost holds the body. Targets are computed
+// from the sizes before the code they jump over is written
+static void emit_level(Generator* g, int level, const GenBody* body, int base, int window) {
+    const GenConfig* config = g->config;
+    int innermost = level == config->depth;
+    emit(g, "MOV R%d, %d", level, gen_range(g, config->min_trips, config->max_trips));
+    long long head = g->written;
+    long long step = head + (innermost ? body_records(body) + (window ? 3 : 0) :
+                                         level_records(config, level + 1, body, window));
+    long long exit_record = head - 1 + level_records(config, level, body, window);
+    long long reset = step + 4;
+    if (!innermost) {
+        emit_level(g, level + 1, body, base, window);
+    } else {
+        emit_body(g, body);
+        if (window) {
+            emit(g, "MOV R4, %d", (base + window) & 0xff);
+            emit(g, "CMP R5, R4");
+            emit(g, "JE %lld", gen_line(g, reset));
+        }
+    }
+    emit(g, "ADD R%d, -1", level);
+    emit(g, "CMP R%d, R6", level);
+    emit(g, "JE %lld", gen_line(g, exit_record));
+    emit(g, "JMP %lld", gen_line(g, head));
+    if (innermost && window) {
+        emit(g, "MOV R5, %d", base);
+        emit(g, "JMP %lld", gen_line(g, step));
+    }
+}
+
+static void emit_kernel(Generator* g, const GenBody* body) {
+    int base = gen_range(g, 0, 255);
+    int window = window_size(g->config, body);
+    emit(g, "MOV R5, %d", base);
+    if (g->config->depth == 0) {
+        emit_body(g, body);
+    } else {
+        emit_level(g, 1, body, base, window);
+    }
+}
+
+// one program of config->lines records, returns -1 if it could not be written
+static int generate(FILE* out, const GenConfig* config) {
+    Generator g = {out, config, 0, config->seed};
+    GenBody body;
+    body.is_memory = malloc((size_t)config->body * 3 / 2 + 1);
+    if (!body.is_memory) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    emit(&g, "MOV R6, 0");
+    emit(&g, "MOV R4, 0");
+    while (g.written < config->lines) {
+        long long room = config->lines - g.written;
+        // body sizes vary around the requested one
+        int count = gen_range(&g, (config->body + 1) / 2, config->body * 3 / 2);
+        draw_body(&g, &body, count);
+        long long size = kernel_overhead(config, window_size(config, &body) != 0) + body_records(&body);
+        if (size > room) {
+            break;
+        }
+        emit_kernel(&g, &body);
+    }
+    // straight-line filler up to the exact size
+    while (g.written < config->lines) {
+        emit_alu(&g);
+    }
+    free(body.is_memory);
+    return ferror(out) ? -1 : 0;
+}
+
+static int parse_count(const char* text, long long low, long long high, long long* value) {
+    char* end;
+    errno = 0;
+    *value = strtoll(text, &end, 10);
+    return (end == text || *end != '\0' || errno != 0 || *value < low || *value > high) ? -1 : 0;
+}
+
+// N or A:B
+static int parse_trips(const char* text, GenConfig* config) {
+    long long low, high;
+    const char* colon = strchr(text, ':');
+    char first[32];
+    if (!colon) {
+        if (parse_count(text, 1, 255, &low) != 0) {
+            return -1;
+        }
+        config->min_trips = config->max_trips = (int)low;
+        return 0;
+    }
+    if ((size_t)(colon - text) >= sizeof(first)) {
+        return -1;
+    }
+    memcpy(first, text, (size_t)(colon - text));
+    first[colon - text] = '\0';
+    if (parse_count(first, 1, 255, &low) != 0 || parse_count(colon + 1, low, 255, &high) != 0) {
+        return -1;
+    }
+    config->min_trips = (int)low;
+    config->max_trips = (int)high;
+    return 0;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [-o <file>]\n", program);
+    fprintf(stderr, "       %s [options] --suite N <directory>\n", program);
+    fprintf(stderr, "  --seed S             generator seed (default 1), suites use S, S+1, ...\n");
+    fprintf(stderr, "  --lines N            program size in records (default 1000)\n");
+    fprintf(stderr, "  --depth D            loop nesting of each kernel, 0-%d (default 2)\n", GEN_MAX_DEPTH);
+    fprintf(stderr, "  --trips N|A:B        trip count of each loop, 1-255 (default 2:20)\n");
+    fprintf(stderr, "  --body N             operations in the innermost body (default 8)\n");
+    fprintf(stderr, "  --memory-ratio F     fraction of body operations that are LD/ST (default 0.3)\n");
+    fprintf(stderr, "  --store-ratio F      fraction of LD/ST that are stores (default 0.5)\n");
+    fprintf(stderr, "  --reuse N            distinct addresses per kernel stream, 1-256 (default 256)\n");
+    fprintf(stderr, "  --numbering explicit|implicit   line numbers in the text (default implicit)\n");
+    fprintf(stderr, "  --first-line N       first line number with explicit numbering (default 1)\n");
+}
+
+int main(int argc, char* argv[]) {
+    GenConfig config = {1000, 2, 2, 20, 8, 0.3, 0.5, 256, 0, 1, 1};
+    const char* output = NULL;
+    const char* suite_dir = NULL;
+    long long suite = 0;
+    long long value;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* next = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = next != NULL;
+        if (strcmp(arg, "-o") == 0 && next) {
+            output = next;
+        } else if (strcmp(arg, "--seed") == 0 && next) {
+            ok = parse_count(next, 0, INT64_MAX, &value) == 0;
+            config.seed = (uint64_t)value;
+        } else if (strcmp(arg, "--lines") == 0 && next) {
+            ok = parse_count(next, 1, 100000000, &config.lines) == 0;
+        } else if (strcmp(arg, "--depth") == 0 && next) {
+            ok = parse_count(next, 0, GEN_MAX_DEPTH, &value) == 0;
+            config.depth = (int)value;
+        } else if (strcmp(arg, "--trips") == 0 && next) {
+            ok = parse_trips(next, &config) == 0;
+        } else if (strcmp(arg, "--body") == 0 && next) {
+            ok = parse_count(next, 1, 100000, &value) == 0;
+            config.body = (int)value;
+        } else if ((strcmp(arg, "--memory-ratio") == 0 || strcmp(arg, "--store-ratio") == 0) && next) {
+            double ratio = atof(next);
+            ok = ratio >= 0.0 && ratio <= 1.0;
+            *(arg[2] == 'm' ? &config.memory_ratio : &config.store_ratio) = ratio;
+        } else if (strcmp(arg, "--reuse") == 0 && next) {
+            ok = parse_count(next, 1, 256, &value) == 0;
+            config.reuse = (int)value;
+        } else if (strcmp(arg, "--numbering") == 0 && next) {
+            ok = strcmp(next, "explicit") == 0 || strcmp(next, "implicit") == 0;
+            config.explicit_lines = strcmp(next, "explicit") == 0;
+        } else if (strcmp(arg, "--first-line") == 0 && next) {
+            ok = parse_count(next, 0, 1000000000, &value) == 0;
+            config.first_line = (int)value;
+        } else if (strcmp(arg, "--suite") == 0 && i + 2 < argc) {
+            ok = parse_count(next, 1, 1000000, &suite) == 0;
+            suite_dir = argv[i + 2];
+            i++;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    // without explicit numbers the first record is line 0
+    if (!config.explicit_lines) {
+        config.first_line = 0;
+    }
+    if ((long long)config.first_line + config.lines > 2000000000LL || (suite_dir && output)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!suite_dir) {
+        FILE* out = output ? fopen(output, "w") : stdout;
+        if (!out) {
+            fprintf(stderr, "Error: Could not open file %s\n", output);
+            return 1;
+        }
+        int result = generate(out, &config);
+        if (output && fclose(out) != 0) {
+            result = -1;
+        }
+        if (result != 0) {
+            fprintf(stderr, "Error: Could not write %s\n", output ? output : "the program");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (mkdir(suite_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Could not create directory %s\n", suite_dir);
+        return 1;
+    }
+    uint64_t first_seed = config.seed;
+    for (long long n = 0; n < suite; n++) {
+        char path[4096];
+        config.seed = first_seed + (uint64_t)n;
+        snprintf(path, sizeof(path), "%s/gen_%06lld.assembly", suite_dir, n);
+        FILE* out = fopen(path, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Could not open file %s\n", path);
+            return 1;
+        }
+        int result = generate(out, &config);
+        if (fclose(out) != 0 || result != 0) {
+            fprintf(stderr, "Error: Could not write %s\n", path);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,3119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#ifdef JIT_BACKEND
+#if !defined(__x86_64__)
+#error "JIT_BACKEND generates x86-64 code and needs an x86-64 host"
+#endif
+#include <sys/mman.h>
+#endif
+#if defined(ISS_PROFILE) && (defined(THREADED_DISPATCH) || defined(JIT_BACKEND))
+#error "ISS_PROFILE instruments the switch interpreter, build it without THREADED_DISPATCH and JIT_BACKEND"
+#endif
+
+#include "iss.h"
+#include "source.h"
+#include "trace.h"
+
+#define LOCAL_MEMORY_SIZE 256
+
+// Instruction types
+typedef enum {
+    MOV_REG_IMM = 0,
+    MOV_REG_REG = 1,
+    ADD_REG_REG = 2,
+    ADD_REG_IMM = 3,
+    CMP_REG_REG = 4,
+    JE_ADDR = 5,
+    JMP_ADDR = 6,
+    LD_REG_REG = 7,
+    ST_REG_REG = 8,
+    LD_REV_REG_REG = 9,  // backward format: LD [Rm], Rn
+    INVALID = 10,
+    // superinstructions, only produced by fuse_superinstructions()
+    CMP_JE = 11,           // CMP arg1, arg2 / JE arg3
+    CMP_JE_JMP = 12,       // CMP arg1, arg2 / JE arg3 / JMP arg4
+    ADD_IMM_ADD_IMM = 13,  // ADD arg1, #arg2 / ADD arg3, #arg4
+    ADD_REG_ADD_IMM = 14,  // ADD arg1, arg2 / ADD arg3, #arg4
+    LD_ADD_IMM = 15,       // LD arg1, [arg2] / ADD arg3, #arg4
+    LD_ADD_REG = 16,       // LD arg1, [arg2] / ADD arg3, arg4
+    LOOP_ENTRY = 17        // head of a counted loop, arg1 = loops[] index
+} InstructionType;
+
+#define FUSION_KINDS 4
+
+// Pre-decoded instruction
+typedef struct {
+    InstructionType type;
+    int arg1;  // register number or address
+    int arg2;  // register number or immediate value
+    int arg3;  // extra operands, superinstructions only
+    int arg4;
+} Instruction;
+
+// Memory simulation
+typedef struct {
+    uint8_t memory[256];
+    uint8_t touched[256];  // track which addresses have been accessed
+} Memory;
+
+// CPU simulation
+typedef struct {
+    int8_t registers[7]; // R1-R6 (index 1-6), index 0 unused
+    uint8_t zero_flag; // for cmp instruction
+} CPU;
+
+#ifdef THREADED_DISPATCH
+// Direct-threaded instruction: handler is the label address of its
+// implementation and JE/JMP carry a pointer to the target record, so
+// the hot loop never indexes the instruction array or switches on type
+typedef struct ThreadedInstruction {
+    const void* handler;
+    const struct ThreadedInstruction* target;
+    const struct ThreadedInstruction* target2; // JMP target of CMP_JE_JMP
+    const void* head_handler; // loop heads: handler of the replaced record
+    const void* block_handler; // leaders under a budget or trace: handler after op_block
+    int loop;                 // loop heads: loops[] index, -1 otherwise
+    InstructionType type;
+    int arg1;
+    int arg2;
+    int arg3;
+    int arg4;
+} ThreadedInstruction;
+#endif
+
+// Basic blocks. Leaders are the entry, branch targets and the instruction
+// after a JE/JMP, so control only ever enters a block at its first record
+// and leaves it at its last. Instruction, cycle and LD/ST counts are summed
+// once here; the engines add a block's totals on entry and LD/ST only add
+// their cache latency as they run.
+typedef struct {
+    int end;            // one past the last record, 0 for non-leaders
+    int instructions;
+    int cycles;         // 1 per instruction, 0 for INVALID, cache latency excluded
+    int memory_ops;
+} BasicBlock;
+
+
+// Analytic fast-forward for counted loops. A candidate is a backward JMP at
+// tail to head whose body is straight-line ADD/CMP/LD/ST code with a single
+// CMP followed by a single exit JE. Registers then change by a constant
+// stride per iteration (mod 256), so the exit iteration is the solution of a
+// linear congruence and the final state follows in closed form. The shape is
+// checked once at load, the trip count from the live registers at run time.
+typedef struct {
+    int head;                     // loop head, target of the backward JMP
+    int tail;                     // index of the backward JMP
+    int exit_branch;              // index of the exit JE
+    int exit_target;              // JE target, outside the body
+    int compare;                  // index of the CMP feeding the exit JE
+    int first_instructions;       // head..exit JE, runs k + 1 times
+    int second_instructions;      // after the exit JE up to the JMP, runs k times
+    int first_cycles;             // static cycles of each part, LD/ST latency excluded
+    int second_cycles;
+    Instruction head_instruction; // record the LOOP_ENTRY marker replaced
+} LoopSummary;
+
+#define MAX_LOOP_MEMORY_OPS 16
+
+// one LD/ST in a loop body as an arithmetic progression over iterations
+typedef struct {
+    uint8_t addr;        // address in the first iteration
+    uint8_t addr_step;
+    uint8_t value;       // stores: value in the first iteration
+    uint8_t value_step;
+    uint8_t is_store;
+    uint8_t split_side;  // after the exit JE, so one run fewer
+    int dest;            // loads: destination register
+#ifdef ISS_PROFILE
+    int pc;
+#endif
+} LoopMemoryOp;
+
+// result of one fast-forward, added to the engine's counters
+typedef struct {
+    long long instructions;
+    long long cycles;
+    long long hits;
+    long long memory_ops;
+    int exit_target;
+} LoopOutcome;
+
+#ifdef ISS_PROFILE
+// Per-PC profile of the last iss_run, one flat entry per decoded record.
+// The engine only counts block entries at leaders and misses at LD/ST,
+// everything else follows from the block table when the report is built:
+// every record of a block runs once per entry, an LD/ST hits on the runs it
+// does not miss, and cycles are 1 per instruction plus its cache latency.
+typedef struct {
+    long long block_runs;  // leaders only
+    long long misses;      // LD/ST only
+} ProfileCounter;
+#endif
+
+#ifdef JIT_BACKEND
+// final counters, written by the generated code's epilogue
+typedef struct {
+    uint64_t executed;
+    uint64_t cycles;
+    uint64_t hits;
+    uint64_t memory_ops;
+    uint64_t budget_exhausted;
+} JitCounters;
+#endif
+
+#define RUN_HALTED (-1)       // resume_pc once the program halted
+#define RUN_UNRESUMABLE (-2)  // stopped inside generated code, which keeps no pc
+
+// Everything one simulation owns. cpu stays the first member so generated
+// code can reach the registers at small offsets from the context pointer.
+struct IssContext {
+    CPU cpu;
+    Memory memory;
+    IssOptions options;
+    Instruction* instructions;
+    int instruction_count;
+    int first_line_number;
+    BasicBlock* blocks;
+    IssStats stats;
+    int resume_pc;      // leader a stopped run continues at, or RUN_HALTED / RUN_UNRESUMABLE
+    uint64_t program_checksum;  // of plain_instructions for checkpoints, 0 until needed
+    SourceText binary;  // mapped .issbin, owns plain_instructions and blocks when set
+    
+    // superinstruction fusion
+    int fusion_enabled;
+    int fusion_sites[FUSION_KINDS];     // CMP+JE, CMP+JE+JMP, ADD+ADD, LD+ADD
+    long long fusion_saved_dispatches;  // dynamic, filled in by iss_run
+    
+    // counted-loop fast-forward
+    int fast_forward_enabled;
+    Instruction* plain_instructions;    // as decoded, before any pass rewrites records
+    LoopSummary* loops;
+    int loop_count;
+    
+    // optional set-associative cache model, replaces memory.touched[] when enabled
+    CacheModel cache_model;
+    int cache_model_enabled;
+    TraceWriter* trace;  // execution trace of the runs, NULL when off
+#ifdef ISS_PROFILE
+    ProfileCounter* profile;
+#endif
+#ifdef THREADED_DISPATCH
+    ThreadedInstruction* threaded_code;
+#endif
+#ifdef JIT_BACKEND
+    JitCounters jit_counters;
+    uint8_t* jit_code;
+    size_t jit_code_size;
+#endif
+};
+
+// Check local memory for an address, returns 1 on a hit
+static int is_local_memory_hit(IssContext* ctx, uint8_t addr) {
+    if (ctx->cache_model_enabled) {
+        return cache_model_access(&ctx->cache_model, addr);
+    }
+    if (!ctx->memory.touched[addr]) {
+        ctx->memory.touched[addr] = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// Parse integer from a line span
+static int parse_int(const char* str, const char* end) {
+    return span_atoi(str, end);
+}
+
+// Parse register number from string like "R1"
+static int parse_register(const char* str, const char* end) {
+    if (str < end && str[0] == 'R') {
+        return span_atoi(str + 1, end);
+    }
+    return -1;
+}
+
+static const char* skip_spaces(const char* ptr, const char* end) {
+    while (ptr < end && *ptr == ' ') ptr++;
+    return ptr;
+}
+
+// Parse instruction from a line, [line, end) without the newline
+static Instruction parse_instruction_line(const char* line, const char* end) {
+    Instruction inst = {INVALID, 0, 0, 0, 0};
+    
+    // Skip leading whitespace and line number
+    const char* ptr = line;
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) ptr++;
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') ptr++;
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) ptr++;
+    
+    // Parse instruction mnemonic
+    if (span_starts_with(ptr, end, "MOV")) {
+        ptr = skip_spaces(ptr + 3, end);
+        
+        int reg = parse_register(ptr, end);
+        if (reg >= 1 && reg <= 6) {
+            const char* comma = span_find(ptr, end, ',');
+            if (comma) {
+                comma = skip_spaces(comma + 1, end);
+                
+                if (comma < end && comma[0] == 'R') {
+                    // MOV Rn, Rm - treat as MOV with immediate from register
+                    int src_reg = parse_register(comma, end);
+                    if (src_reg >= 1 && src_reg <= 6) {
+                        inst.type = MOV_REG_IMM;
+                        inst.arg1 = reg;
+                        inst.arg2 = 0; // will be resolved at execution
+                    }
+                } else {
+                    inst.type = MOV_REG_IMM;
+                    inst.arg1 = reg;
+                    inst.arg2 = parse_int(comma, end);
+                }
+            }
+        }
+    }
+    else if (span_starts_with(ptr, end, "ADD")) {
+        ptr = skip_spaces(ptr + 3, end);
+        
+        int reg = parse_register(ptr, end);
+        if (reg >= 1 && reg <= 6) {
+            const char* comma = span_find(ptr, end, ',');
+            if (comma) {
+                comma = skip_spaces(comma + 1, end);
+                
+                if (comma < end && comma[0] == 'R') {
+                    inst.type = ADD_REG_REG;
+                    inst.arg1 = reg;
+                    inst.arg2 = parse_register(comma, end);
+                } else {
+                    inst.type = ADD_REG_IMM;
+                    inst.arg1 = reg;
+                    inst.arg2 = parse_int(comma, end);
+                }
+            }
+        }
+    }
+    else if (span_starts_with(ptr, end, "CMP")) {
+        ptr = skip_spaces(ptr + 3, end);
+        
+        int reg1 = parse_register(ptr, end);
+        if (reg1 >= 1 && reg1 <= 6) {
+            const char* comma = span_find(ptr, end, ',');
+            if (comma) {
+                comma = skip_spaces(comma + 1, end);
+                
+                int reg2 = parse_register(comma, end);
+                if (reg2 >= 1 && reg2 <= 6) {
+                    inst.type = CMP_REG_REG;
+                    inst.arg1 = reg1;
+                    inst.arg2 = reg2;
+                }
+            }
+        }
+    }
+    else if (span_starts_with(ptr, end, "JE")) {
+        ptr = skip_spaces(ptr + 2, end);
+        
+        inst.type = JE_ADDR;
+        inst.arg1 = parse_int(ptr, end);
+        inst.arg2 = 0;
+    }
+    else if (span_starts_with(ptr, end, "JMP")) {
+        ptr = skip_spaces(ptr + 3, end);
+        
+        inst.type = JMP_ADDR;
+        inst.arg1 = parse_int(ptr, end);
+        inst.arg2 = 0;
+    }
+    else if (span_starts_with(ptr, end, "LD")) {
+        ptr = skip_spaces(ptr + 2, end);
+        
+        // Check if brackets come before comma (backward format)
+        const char* comma = span_find(ptr, end, ',');
+        const char* bracket_start = span_find(ptr, end, '[');
+        
+        if (comma && bracket_start && bracket_start < comma) {
+            // LD [Rm], Rn - backward format
+            bracket_start = skip_spaces(bracket_start + 1, end);
+            
+            int addr_reg = parse_register(bracket_start, end);
+            if (addr_reg >= 1 && addr_reg <= 6) {
+                comma = skip_spaces(comma + 1, end);
+                
+                int dest_reg = parse_register(comma, end);
+                if (dest_reg >= 1 && dest_reg <= 6) {
+                    inst.type = LD_REV_REG_REG;
+                    inst.arg1 = addr_reg;
+                    inst.arg2 = dest_reg;
+                }
+            }
+        } else {
+            // LD Rn, [Rm] - normal format
+            int reg = parse_register(ptr, end);
+            if (reg >= 1 && reg <= 6) {
+                comma = span_find(ptr, end, ',');
+                if (comma) {
+                    bracket_start = span_find(comma, end, '[');
+                    if (bracket_start) {
+                        bracket_start = skip_spaces(bracket_start + 1, end);
+                        
+                        int addr_reg = parse_register(bracket_start, end);
+                        if (addr_reg >= 1 && addr_reg <= 6) {
+                            inst.type = LD_REG_REG;
+                            inst.arg1 = reg;
+                            inst.arg2 = addr_reg;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    else if (span_starts_with(ptr, end, "ST")) {
+        ptr = skip_spaces(ptr + 2, end);
+        
+        const char* bracket_start = span_find(ptr, end, '[');
+        if (bracket_start) {
+            bracket_start = skip_spaces(bracket_start + 1, end);
+            
+            int addr_reg = parse_register(bracket_start, end);
+            if (addr_reg >= 1 && addr_reg <= 6) {
+                const char* bracket_end = span_find(bracket_start, end, ']');
+                if (bracket_end) {
+                    const char* comma = span_find(bracket_end, end, ',');
+                    if (comma) {
+                        comma = skip_spaces(comma + 1, end);
+                        
+                        int reg = parse_register(comma, end);
+                        if (reg >= 1 && reg <= 6) {
+                            inst.type = ST_REG_REG;
+                            inst.arg1 = addr_reg;
+                            inst.arg2 = reg;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    return inst;
+}
+
+// Decode the program text in place. Every line, comments included, counts
+// towards the record array, which is allocated once from the line count.
+static Instruction* get_instructions_from_text(const SourceText* text, int* line_count, int* first_line) {
+    size_t lines = source_count_lines(text);
+    const char* cursor = text->data;
+    const char* line_end;
+    const char* line;
+    
+    // The first line gives the starting line number
+    if ((line = source_next_line(text, &cursor, &line_end)) != NULL) {
+        const char* ptr = line;
+        while (ptr < line_end && (*ptr == ' ' || (*ptr >= '\t' && *ptr <= '\r'))) ptr++;
+        if (ptr < line_end && (*ptr == '-' || *ptr == '+')) ptr++;
+        if (ptr < line_end && *ptr >= '0' && *ptr <= '9') {
+            *first_line = span_atoi(line, line_end);
+        }
+    }
+    if (*first_line < 0) {
+        fprintf(stderr, "Error: negative first line number %d\n", *first_line);
+        return NULL;
+    }
+    if (lines > (size_t)INT_MAX - (size_t)*first_line) {
+        fprintf(stderr, "Error: program too large\n");
+        return NULL;
+    }
+    *line_count = (int)lines;
+    
+    // Allocate instruction array
+    Instruction* insts = malloc(((size_t)*line_count + (size_t)*first_line) * sizeof(Instruction));
+    if (!insts) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    
+    // Initialize all instructions to INVALID
+    for (int i = 0; i < *line_count + *first_line; i++) {
+        insts[i].type = INVALID;
+        insts[i].arg1 = 0;
+        insts[i].arg2 = 0;
+        insts[i].arg3 = 0;
+        insts[i].arg4 = 0;
+    }
+    
+    // Parse instructions
+    int idx = *first_line;
+    cursor = text->data;
+    while ((line = source_next_line(text, &cursor, &line_end)) != NULL) {
+        // Skip empty lines, comments, and labels (lines ending with ':')
+        if (line == line_end || line[0] == '#' || line[0] == ';' || line_end[-1] == ':') {
+            continue;
+        }
+        
+        insts[idx] = parse_instruction_line(line, line_end);
+        idx++;
+    }
+    
+    return insts;
+}
+
+static int is_block_leader(const IssContext* ctx, int i) {
+    return ctx->blocks[i].end != 0;
+}
+
+// a register operand the JIT, lanes and emitted C can address, R0-R7 like
+// the interpreter
+static int register_operand_ok(int reg) {
+    return reg >= 0 && reg <= 7;
+}
+
+// every register operand of inst passes register_operand_ok
+static int instruction_registers_ok(Instruction inst) {
+    switch (inst.type) {
+        case MOV_REG_IMM:
+        case ADD_REG_IMM:
+            return register_operand_ok(inst.arg1);
+        case MOV_REG_REG:
+        case ADD_REG_REG:
+        case CMP_REG_REG:
+        case LD_REG_REG:
+        case LD_REV_REG_REG:
+        case ST_REG_REG:
+            return register_operand_ok(inst.arg1) && register_operand_ok(inst.arg2);
+        default:
+            return 1;
+    }
+}
+
+// leader[0..end] of a plain program: the first record, the entry, branch
+// targets and the record after each JE/JMP
+static void mark_block_leaders(const Instruction* program, int end, int first_line, uint8_t* leader) {
+    if (end > 0) {
+        leader[0] = 1;
+    }
+    leader[first_line] = 1;
+    for (int i = 0; i < end; i++) {
+        if (program[i].type == JE_ADDR || program[i].type == JMP_ADDR) {
+            int target = program[i].arg1;
+            if (target >= 0 && target < end) {
+                leader[target] = 1;
+            }
+            leader[i + 1] = 1;
+        }
+    }
+}
+
+// built from the unfused program, before any pass rewrites records
+static int build_basic_blocks(IssContext* ctx) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    
+    ctx->blocks = calloc((size_t)end + 1, sizeof(BasicBlock));
+    uint8_t* leader = calloc((size_t)end + 1, 1);
+    if (!ctx->blocks || !leader) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(leader);
+        return -1;
+    }
+    
+    // mark leaders, then size each block up to the next one
+    mark_block_leaders(ctx->instructions, end, ctx->first_line_number, leader);
+    for (int i = 0; i < end; i++) {
+        if (!leader[i]) {
+            continue;
+        }
+        BasicBlock* block = &ctx->blocks[i];
+        int j = i;
+        do {
+            InstructionType type = ctx->instructions[j].type;
+            block->instructions++;
+            if (type != INVALID) {
+                block->cycles++;
+            }
+            if (type == LD_REG_REG || type == LD_REV_REG_REG || type == ST_REG_REG) {
+                block->memory_ops++;
+            }
+            j++;
+        } while (j < end && !leader[j]);
+        block->end = j;
+    }
+    free(leader);
+    return 0;
+}
+
+// Decode-time peephole pass: the head of each common sequence is replaced by
+// a superinstruction that executes the whole sequence in one dispatch. The
+// following records are left untouched, so a branch into the middle of a
+// sequence still runs the original instructions. Sequences never cross into
+// another basic block, except the JMP after CMP+JE which is a block of its own.
+static void fuse_superinstructions(IssContext* ctx) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    
+    for (int i = 0; i + 1 < end; i++) {
+        Instruction a = ctx->instructions[i];
+        Instruction b = ctx->instructions[i + 1];
+        Instruction* head = &ctx->instructions[i];
+        
+        if (is_block_leader(ctx, i + 1)) {
+            continue;
+        }
+
+        if (a.type == CMP_REG_REG && b.type == JE_ADDR) {
+            if (i + 2 < end && ctx->instructions[i + 2].type == JMP_ADDR) {
+                head->type = CMP_JE_JMP;
+                head->arg4 = ctx->instructions[i + 2].arg1;
+                ctx->fusion_sites[1]++;
+            } else {
+                head->type = CMP_JE;
+                ctx->fusion_sites[0]++;
+            }
+            head->arg3 = b.arg1;
+        } else if ((a.type == ADD_REG_IMM || a.type == ADD_REG_REG) && b.type == ADD_REG_IMM) {
+            head->type = (a.type == ADD_REG_IMM) ? ADD_IMM_ADD_IMM : ADD_REG_ADD_IMM;
+            head->arg3 = b.arg1;
+            head->arg4 = b.arg2;
+            ctx->fusion_sites[2]++;
+        } else if ((a.type == LD_REG_REG || a.type == LD_REV_REG_REG) &&
+                   (b.type == ADD_REG_IMM || b.type == ADD_REG_REG)) {
+            // normalise to dest = arg1, address register = arg2
+            if (a.type == LD_REV_REG_REG) {
+                head->arg1 = a.arg2;
+                head->arg2 = a.arg1;
+            }
+            head->type = (b.type == ADD_REG_IMM) ? LD_ADD_IMM : LD_ADD_REG;
+            head->arg3 = b.arg1;
+            head->arg4 = b.arg2;
+            ctx->fusion_sites[3]++;
+        }
+    }
+}
+
+void iss_print_fusion_stats(const IssContext* ctx, FILE* out) {
+    static const char* const names[FUSION_KINDS] = {"CMP+JE", "CMP+JE+JMP", "ADD+ADD", "LD+ADD"};
+    for (int k = 0; k < FUSION_KINDS; k++) {
+        fprintf(out, "Fusion %s: %d sites\n", names[k], ctx->fusion_sites[k]);
+    }
+    fprintf(out, "Dispatches saved by fusion: %lld\n", ctx->fusion_saved_dispatches);
+}
+
+static int loop_register_ok(int reg) {
+    return reg >= 1 && reg <= 6;
+}
+
+// check the static shape of the loop head..tail, fill in summary if it fits
+static int analyze_loop(const IssContext* ctx, int head, int tail, LoopSummary* summary) {
+    int exit_branch = -1;
+    int compare = -1;
+    int has_load = 0;
+    int has_store = 0;
+    uint8_t written[7] = {0};   // ADD destinations
+    uint8_t loaded[7] = {0};    // LD destinations
+    uint8_t uses[7] = {0};      // every register operand
+    
+    for (int p = head; p < tail; p++) {
+        Instruction inst = ctx->instructions[p];
+        switch (inst.type) {
+            case ADD_REG_IMM:
+                if (!loop_register_ok(inst.arg1)) return 0;
+                written[inst.arg1] = 1;
+                uses[inst.arg1]++;
+                break;
+            case ADD_REG_REG:
+                if (!loop_register_ok(inst.arg1) || !loop_register_ok(inst.arg2)) return 0;
+                written[inst.arg1] = 1;
+                uses[inst.arg1]++;
+                uses[inst.arg2]++;
+                break;
+            case CMP_REG_REG:
+                if (compare >= 0 || exit_branch >= 0) return 0;
+                compare = p;
+                uses[inst.arg1]++;
+                uses[inst.arg2]++;
+                break;
+            case JE_ADDR:
+                if (exit_branch >= 0 || compare < 0) return 0;
+                if (inst.arg1 >= head && inst.arg1 <= tail) return 0;
+                exit_branch = p;
+                break;
+            case LD_REG_REG:
+            case LD_REV_REG_REG:
+                {
+                    int dest = (inst.type == LD_REG_REG) ? inst.arg1 : inst.arg2;
+                    int addr = (inst.type == LD_REG_REG) ? inst.arg2 : inst.arg1;
+                    if (!loop_register_ok(dest) || !loop_register_ok(addr)) return 0;
+                    loaded[dest] = 1;
+                    uses[dest]++;
+                    uses[addr]++;
+                    has_load = 1;
+                }
+                break;
+            case ST_REG_REG:
+                if (!loop_register_ok(inst.arg1) || !loop_register_ok(inst.arg2)) return 0;
+                uses[inst.arg1]++;
+                uses[inst.arg2]++;
+                has_store = 1;
+                break;
+            case INVALID:
+                break;
+            default:
+                // MOV or a second branch: not an induction-variable loop
+                return 0;
+        }
+    }
+    if (exit_branch < 0 || (has_load && has_store)) {
+        return 0;
+    }
+    int memory_op_count = 0;
+    for (int p = head; p < tail; p++) {
+        InstructionType type = ctx->instructions[p].type;
+        memory_op_count += (type == LD_REG_REG || type == LD_REV_REG_REG || type == ST_REG_REG);
+    }
+    if (memory_op_count > MAX_LOOP_MEMORY_OPS) {
+        return 0;
+    }
+    for (int p = head; p < tail; p++) {
+        Instruction inst = ctx->instructions[p];
+        // ADD sources must be loop invariant so the stride is constant
+        if (inst.type == ADD_REG_REG && (written[inst.arg2] || loaded[inst.arg2] || inst.arg1 == inst.arg2)) {
+            return 0;
+        }
+    }
+    for (int r = 1; r <= 6; r++) {
+        // a loaded value must not feed anything else in the body
+        if (loaded[r] && uses[r] != 1) {
+            return 0;
+        }
+    }
+    
+    summary->head = head;
+    summary->tail = tail;
+    summary->exit_branch = exit_branch;
+    summary->exit_target = ctx->instructions[exit_branch].arg1;
+    summary->compare = compare;
+    summary->first_instructions = exit_branch - head + 1;
+    summary->second_instructions = tail - exit_branch;
+    summary->first_cycles = 0;
+    summary->second_cycles = 0;
+    for (int p = head; p <= tail; p++) {
+        if (ctx->instructions[p].type != INVALID) {
+            if (p <= exit_branch) {
+                summary->first_cycles++;
+            } else {
+                summary->second_cycles++;
+            }
+        }
+    }
+    summary->head_instruction = ctx->instructions[head];
+    return 1;
+}
+
+// find loop candidates in the unfused program
+static int find_counted_loops(IssContext* ctx) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    
+    ctx->loops = malloc(((size_t)end + 1) * sizeof(LoopSummary));
+    if (!ctx->loops) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    ctx->loop_count = 0;
+    
+    for (int tail = 0; tail < end; tail++) {
+        int head = ctx->instructions[tail].arg1;
+        if (ctx->instructions[tail].type != JMP_ADDR || head < 0 || head >= tail) {
+            continue;
+        }
+        int duplicate = 0;
+        for (int l = 0; l < ctx->loop_count; l++) {
+            duplicate |= (ctx->loops[l].head == head);
+        }
+        if (!duplicate && analyze_loop(ctx, head, tail, &ctx->loops[ctx->loop_count])) {
+            ctx->loop_count++;
+        }
+    }
+    return 0;
+}
+
+// Replace each loop head by a LOOP_ENTRY marker, after fusion so the saved
+// head is whatever the engine would have executed there
+static void install_loop_entries(IssContext* ctx) {
+    for (int l = 0; l < ctx->loop_count; l++) {
+        ctx->loops[l].head_instruction = ctx->instructions[ctx->loops[l].head];
+        ctx->instructions[ctx->loops[l].head].type = LOOP_ENTRY;
+        ctx->instructions[ctx->loops[l].head].arg1 = l;
+    }
+}
+
+// smallest k >= 0 with k * d == c (mod 256), -1 if there is none
+static int solve_trip_count(uint8_t d, uint8_t c) {
+    if (d == 0) {
+        return (c == 0) ? 0 : -1;
+    }
+    int shift = 0;
+    while (((d >> shift) & 1) == 0) {
+        shift++;
+    }
+    if (c & ((1u << shift) - 1)) {
+        return -1; // gcd(d, 256) does not divide c
+    }
+    uint32_t modulus = 256u >> shift;
+    uint32_t odd = (uint32_t)d >> shift;
+    // inverse of an odd number mod 2^n by Newton iteration
+    uint32_t inverse = odd;
+    for (int n = 0; n < 3; n++) {
+        inverse *= 2u - odd * inverse;
+    }
+    return (int)((((uint32_t)c >> shift) * inverse) & (modulus - 1));
+}
+
+// Run the loop at summary in closed form from the current state.
+// Returns 0 (and changes nothing) when the loop never exits, when the cache
+// model is active, whose replacement state depends on access order, or when
+// the loop would take more than room_instructions / room_cycles, so the
+// interpreter stops at the same block boundary with or without fast-forward.
+static int fast_forward_loop(IssContext* ctx, const LoopSummary* summary, long long room_instructions,
+                             long long room_cycles, LoopOutcome* out) {
+    const Instruction* body = ctx->plain_instructions;
+    int head = summary->head;
+    int tail = summary->tail;
+    int split = summary->exit_branch; // positions <= split run k + 1 times
+    uint8_t stride[7] = {0};
+    uint8_t before[7] = {0};          // ADD total before the current position
+    LoopMemoryOp ops[MAX_LOOP_MEMORY_OPS];
+    int op_count = 0;
+    uint8_t c = 0;
+    int a = 0;
+    int b = 0;
+    
+    if (ctx->cache_model_enabled) {
+        return 0;
+    }
+    
+    for (int p = head; p < tail; p++) {
+        if (body[p].type == ADD_REG_IMM) {
+            stride[body[p].arg1] += (uint8_t)body[p].arg2;
+        } else if (body[p].type == ADD_REG_REG) {
+            stride[body[p].arg1] += (uint8_t)ctx->cpu.registers[body[p].arg2];
+        }
+    }
+    
+    // value of register r read at position p in iteration n is
+    // r0 + before_p(r) + n * stride(r) (mod 256)
+    for (int p = head; p < tail; p++) {
+        Instruction inst = body[p];
+        switch (inst.type) {
+            case ADD_REG_IMM:
+                before[inst.arg1] += (uint8_t)inst.arg2;
+                break;
+            case ADD_REG_REG:
+                before[inst.arg1] += (uint8_t)ctx->cpu.registers[inst.arg2];
+                break;
+            case CMP_REG_REG:
+                a = inst.arg1;
+                b = inst.arg2;
+                c = (uint8_t)(((uint8_t)ctx->cpu.registers[b] + before[b]) - ((uint8_t)ctx->cpu.registers[a] + before[a]));
+                break;
+            case LD_REG_REG:
+            case LD_REV_REG_REG:
+            case ST_REG_REG:
+                {
+                    LoopMemoryOp* op = &ops[op_count++];
+                    int addr_reg = (inst.type == LD_REG_REG) ? inst.arg2 : inst.arg1;
+                    op->addr = (uint8_t)((uint8_t)ctx->cpu.registers[addr_reg] + before[addr_reg]);
+                    op->addr_step = stride[addr_reg];
+                    op->is_store = (inst.type == ST_REG_REG);
+#ifdef ISS_PROFILE
+                    op->pc = p;
+#endif
+                    op->split_side = (p > split);
+                    op->dest = 0;
+                    op->value = 0;
+                    op->value_step = 0;
+                    if (op->is_store) {
+                        op->value = (uint8_t)((uint8_t)ctx->cpu.registers[inst.arg2] + before[inst.arg2]);
+                        op->value_step = stride[inst.arg2];
+                    } else {
+                        op->dest = (inst.type == LD_REG_REG) ? inst.arg1 : inst.arg2;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    int k = solve_trip_count((uint8_t)(stride[a] - stride[b]), c);
+    if (k < 0) {
+        return 0; // never exits, leave it to the interpreter
+    }
+    long long first_runs = k + 1;
+    long long instructions = first_runs * summary->first_instructions + (long long)k * summary->second_instructions;
+    if (instructions > room_instructions) {
+        return 0;
+    }
+    
+    // each address not touched before costs exactly one miss. The first 256
+    // iterations are walked in program order, addresses repeat after that,
+    // so each miss is also charged to the LD/ST that touched its address
+    // first. Under a cycle budget the misses are counted on a copy first,
+    // the loop may still be handed back to the interpreter
+    uint8_t* touched = ctx->memory.touched;
+    uint8_t scratch[LOCAL_MEMORY_SIZE];
+    if (ctx->options.max_cycles > 0) {
+        memcpy(scratch, touched, sizeof(scratch));
+        touched = scratch;
+    }
+    long long memory_ops = 0;
+    long long misses = 0;
+    long long op_misses[MAX_LOOP_MEMORY_OPS] = {0};
+    for (int n = 0; n <= k && n < 256; n++) {
+        for (int o = 0; o < op_count; o++) {
+            if (n == k && ops[o].split_side) {
+                continue;
+            }
+            uint8_t addr = (uint8_t)(ops[o].addr + n * ops[o].addr_step);
+            op_misses[o] += !touched[addr];
+            touched[addr] = 1;
+        }
+    }
+    for (int o = 0; o < op_count; o++) {
+        misses += op_misses[o];
+        memory_ops += ops[o].split_side ? k : k + 1;
+    }
+    long long hits = memory_ops - misses;
+    long long cycles = first_runs * summary->first_cycles + (long long)k * summary->second_cycles +
+                       hits * ctx->options.hit_cycles + misses * ctx->options.miss_cycles;
+    if (cycles > room_cycles) {
+        return 0;
+    }
+    if (touched == scratch) {
+        memcpy(ctx->memory.touched, scratch, sizeof(scratch));
+    }
+#ifdef ISS_PROFILE
+    // every block of the body ran k + 1 or k times, the engine already
+    // counted the head block's entry
+    for (int p = head; p <= tail; p++) {
+        if (is_block_leader(ctx, p)) {
+            ctx->profile[p].block_runs += ((p <= split) ? k + 1 : k) - (p == head);
+        }
+    }
+    for (int o = 0; o < op_count; o++) {
+        ctx->profile[ops[o].pc].misses += op_misses[o];
+    }
+#endif
+    
+    // stores in program order so later writes win, then the last value of
+    // each load (loads and stores never share a loop)
+    for (int n = 0; n <= k; n++) {
+        for (int o = 0; o < op_count; o++) {
+            if (ops[o].is_store && (n < k || !ops[o].split_side)) {
+                ctx->memory.memory[ops[o].addr] = ops[o].value;
+                ops[o].addr = (uint8_t)(ops[o].addr + ops[o].addr_step);
+                ops[o].value = (uint8_t)(ops[o].value + ops[o].value_step);
+            }
+        }
+    }
+    for (int o = 0; o < op_count; o++) {
+        int runs = ops[o].split_side ? k : k + 1;
+        if (!ops[o].is_store && runs > 0) {
+            uint8_t addr = (uint8_t)(ops[o].addr + (runs - 1) * ops[o].addr_step);
+            ctx->cpu.registers[ops[o].dest] = (int8_t)ctx->memory.memory[addr];
+        }
+    }
+    
+    // final registers, every ADD ran k + 1 or k times
+    uint8_t add_total[7] = {0};
+    for (int p = head; p < tail; p++) {
+        uint8_t runs = (uint8_t)((p <= split) ? k + 1 : k);
+        if (body[p].type == ADD_REG_IMM) {
+            add_total[body[p].arg1] += (uint8_t)(runs * (uint8_t)body[p].arg2);
+        } else if (body[p].type == ADD_REG_REG) {
+            add_total[body[p].arg1] += (uint8_t)(runs * (uint8_t)ctx->cpu.registers[body[p].arg2]);
+        }
+    }
+    for (int r = 1; r <= 6; r++) {
+        ctx->cpu.registers[r] = (int8_t)((uint8_t)ctx->cpu.registers[r] + add_total[r]);
+    }
+    ctx->cpu.zero_flag = 1;
+    
+    out->instructions = instructions;
+    out->memory_ops = memory_ops;
+    out->hits = hits;
+    out->cycles = cycles;
+    out->exit_target = summary->exit_target;
+    return 1;
+}
+
+#ifdef THREADED_DISPATCH
+// Build the threaded program at load time. The extra slot at the end is a
+// halt record, branches that leave the program resolve to it.
+static int build_threaded_code(IssContext* ctx) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    ctx->threaded_code = malloc((end + 1) * sizeof(ThreadedInstruction));
+    if (!ctx->threaded_code) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    
+    for (int i = 0; i < end; i++) {
+        ThreadedInstruction* t = &ctx->threaded_code[i];
+        // a loop head keeps the fields of the record it replaced for fallback
+        Instruction inst = ctx->instructions[i];
+        t->loop = -1;
+        if (inst.type == LOOP_ENTRY) {
+            t->loop = inst.arg1;
+            inst = ctx->loops[inst.arg1].head_instruction;
+        }
+        t->handler = NULL;
+        t->head_handler = NULL;
+        t->type = inst.type;
+        t->arg1 = inst.arg1;
+        t->arg2 = inst.arg2;
+        t->arg3 = inst.arg3;
+        t->arg4 = inst.arg4;
+        t->target = NULL;
+        t->target2 = NULL;
+        if (t->type == JE_ADDR || t->type == JMP_ADDR) {
+            int target = t->arg1;
+            t->target = (target >= 0 && target < end) ? &ctx->threaded_code[target] : &ctx->threaded_code[end];
+        } else if (t->type == CMP_JE || t->type == CMP_JE_JMP) {
+            int target = t->arg3;
+            t->target = (target >= 0 && target < end) ? &ctx->threaded_code[target] : &ctx->threaded_code[end];
+            target = t->arg4;
+            t->target2 = (target >= 0 && target < end) ? &ctx->threaded_code[target] : &ctx->threaded_code[end];
+        }
+    }
+    ctx->threaded_code[end].handler = NULL;
+    ctx->threaded_code[end].type = INVALID;
+    ctx->threaded_code[end].target = NULL;
+    ctx->threaded_code[end].target2 = NULL;
+    return 0;
+}
+#endif
+
+#ifdef JIT_BACKEND
+// x86-64 basic-block JIT. Every decoded instruction is translated once into
+// native code in an mmap'd buffer. Block leaders add their block's
+// precomputed instruction, cycle and LD/ST counts in one step, JE/JMP jump
+// straight to the target block's code and only LD/ST call back into C for
+// the cache model. Under a budget each leader first compares the counters
+// with the limits, without one no check is emitted at all. The code is
+// specific to one context, whose addresses and options it embeds.
+//
+// Register use inside generated code:
+//   rbx = ctx (cpu is its first member), rbp = ctx->memory.memory
+//   r12 = executed instructions, r13 = clock cycles
+//   r14 = local memory hits, r15 = LD/ST instructions
+typedef struct {
+    uint8_t* code;
+    size_t size;
+    size_t capacity;
+} JitBuffer;
+
+typedef struct {
+    size_t at;   // offset of the rel32 field
+    int target;  // instruction index, end of program means exit
+    int budget;  // jump to the budget exit instead of target
+} JitPatch;
+
+static void jit_emit8(JitBuffer* b, uint8_t v) {
+    b->code[b->size++] = v;
+}
+
+static void jit_emit32(JitBuffer* b, uint32_t v) {
+    memcpy(b->code + b->size, &v, 4);
+    b->size += 4;
+}
+
+static void jit_emit64(JitBuffer* b, uint64_t v) {
+    memcpy(b->code + b->size, &v, 8);
+    b->size += 8;
+}
+
+// op byte [rbx + disp8] forms used for simulated registers
+static void jit_emit_rbx_disp8(JitBuffer* b, uint8_t opcode, uint8_t modrm_reg, int disp) {
+    jit_emit8(b, opcode);
+    jit_emit8(b, (uint8_t)(0x43 | (modrm_reg << 3)));
+    jit_emit8(b, (uint8_t)(int8_t)disp);
+}
+
+// add r64, imm32 for the counter registers, skipped when zero
+static void jit_emit_add_counter(JitBuffer* b, uint8_t reg_low, uint32_t value) {
+    if (value == 0) {
+        return;
+    }
+    jit_emit8(b, 0x49);
+    jit_emit8(b, 0x81);
+    jit_emit8(b, (uint8_t)(0xC0 | reg_low));
+    jit_emit32(b, value);
+}
+
+// address already in esi, call is_local_memory_hit(ctx, esi), then account it
+static void jit_emit_memory_access(JitBuffer* b, const IssOptions* options) {
+    jit_emit8(b, 0x48); jit_emit8(b, 0x89); jit_emit8(b, 0xDF); // mov rdi, rbx
+    jit_emit8(b, 0x48); jit_emit8(b, 0xB8);                   // mov rax, imm64
+    jit_emit64(b, (uint64_t)(uintptr_t)&is_local_memory_hit);
+    jit_emit8(b, 0xFF); jit_emit8(b, 0xD0);                   // call rax
+    jit_emit8(b, 0x89); jit_emit8(b, 0xC0);                   // mov eax, eax
+    jit_emit8(b, 0xBA); jit_emit32(b, (uint32_t)options->miss_cycles); // mov edx, miss
+    jit_emit8(b, 0xB9); jit_emit32(b, (uint32_t)options->hit_cycles);  // mov ecx, hit
+    jit_emit8(b, 0x85); jit_emit8(b, 0xC0);                   // test eax, eax
+    jit_emit8(b, 0x0F); jit_emit8(b, 0x45); jit_emit8(b, 0xD1); // cmovnz edx, ecx
+    jit_emit8(b, 0x49); jit_emit8(b, 0x01); jit_emit8(b, 0xD5); // add r13, rdx
+    jit_emit8(b, 0x49); jit_emit8(b, 0x01); jit_emit8(b, 0xC6); // add r14, rax
+}
+
+// mov rax, limit / cmp counter, rax / jge budget exit
+static void jit_emit_budget_check(JitBuffer* b, JitPatch* patch, uint8_t reg_low, long long limit) {
+    jit_emit8(b, 0x48); jit_emit8(b, 0xB8); jit_emit64(b, (uint64_t)limit);
+    jit_emit8(b, 0x49); jit_emit8(b, 0x39); jit_emit8(b, (uint8_t)(0xC0 | reg_low));
+    jit_emit8(b, 0x0F); jit_emit8(b, 0x8D);
+    patch->at = b->size;
+    patch->target = 0;
+    patch->budget = 1;
+    jit_emit32(b, 0);
+}
+
+// Translate the whole program. Returns 0 on success, -1 if the program uses
+// something the JIT does not handle (the interpreter is used instead).
+static int jit_compile(IssContext* ctx) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    int reg_base = (int)(offsetof(IssContext, cpu) + offsetof(CPU, registers));
+    int zf = (int)(offsetof(IssContext, cpu) + offsetof(CPU, zero_flag));
+    
+    for (int i = 0; i < end; i++) {
+        if (!instruction_registers_ok(ctx->instructions[i])) {
+            return -1;
+        }
+    }
+    
+    long long max_instructions = ctx->options.max_instructions;
+    long long max_cycles = ctx->options.max_cycles;
+    size_t* offsets = malloc(((size_t)end + 1) * sizeof(size_t));
+    JitPatch* patches = calloc(((size_t)end + 1) * 3, sizeof(JitPatch));
+    if (!offsets || !patches) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(offsets);
+        free(patches);
+        return -1;
+    }
+    
+    // worst case ~64 bytes per instruction plus block prologues and checks
+    JitBuffer b;
+    b.capacity = ((size_t)end + 1) * (max_instructions > 0 || max_cycles > 0 ? 136 : 96) + 256;
+    b.size = 0;
+    b.code = mmap(NULL, b.capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b.code == MAP_FAILED) {
+        free(offsets);
+        free(patches);
+        return -1;
+    }
+    int patch_count = 0;
+    
+    // prologue: save callee-saved registers, keep rsp 16-byte aligned
+    jit_emit8(&b, 0x53);                                    // push rbx
+    jit_emit8(&b, 0x55);                                    // push rbp
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x54);               // push r12
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x55);               // push r13
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x56);               // push r14
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x57);               // push r15
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0x83); jit_emit8(&b, 0xEC); jit_emit8(&b, 0x08); // sub rsp, 8
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0xBB); jit_emit64(&b, (uint64_t)(uintptr_t)ctx);                 // mov rbx
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0xBD); jit_emit64(&b, (uint64_t)(uintptr_t)ctx->memory.memory); // mov rbp
+    jit_emit8(&b, 0x45); jit_emit8(&b, 0x31); jit_emit8(&b, 0xE4); // xor r12d, r12d
+    jit_emit8(&b, 0x45); jit_emit8(&b, 0x31); jit_emit8(&b, 0xED); // xor r13d, r13d
+    jit_emit8(&b, 0x45); jit_emit8(&b, 0x31); jit_emit8(&b, 0xF6); // xor r14d, r14d
+    jit_emit8(&b, 0x45); jit_emit8(&b, 0x31); jit_emit8(&b, 0xFF); // xor r15d, r15d
+    jit_emit8(&b, 0xE9);                                    // jmp entry
+    patches[patch_count].at = b.size;
+    patches[patch_count].target = ctx->first_line_number;
+    patch_count++;
+    jit_emit32(&b, 0);
+    
+    for (int i = 0; i < end; i++) {
+        offsets[i] = b.size;
+        
+        if (is_block_leader(ctx, i)) {
+            const BasicBlock* block = &ctx->blocks[i];
+            if (max_instructions > 0) {
+                jit_emit_budget_check(&b, &patches[patch_count++], 4, max_instructions); // r12
+            }
+            if (max_cycles > 0) {
+                jit_emit_budget_check(&b, &patches[patch_count++], 5, max_cycles);       // r13
+            }
+            jit_emit_add_counter(&b, 4, (uint32_t)block->instructions); // r12
+            jit_emit_add_counter(&b, 5, (uint32_t)block->cycles);       // r13
+            jit_emit_add_counter(&b, 7, (uint32_t)block->memory_ops);   // r15
+        }
+        
+        Instruction inst = ctx->instructions[i];
+        switch (inst.type) {
+            case MOV_REG_IMM:
+                // mov byte [rbx + rd], imm8
+                jit_emit_rbx_disp8(&b, 0xC6, 0, reg_base + inst.arg1);
+                jit_emit8(&b, (uint8_t)inst.arg2);
+                break;
+            case MOV_REG_REG:
+                jit_emit_rbx_disp8(&b, 0x8A, 0, reg_base + inst.arg2); // mov al, [rs]
+                jit_emit_rbx_disp8(&b, 0x88, 0, reg_base + inst.arg1); // mov [rd], al
+                break;
+            case ADD_REG_REG:
+                jit_emit_rbx_disp8(&b, 0x8A, 0, reg_base + inst.arg2); // mov al, [rs]
+                jit_emit_rbx_disp8(&b, 0x00, 0, reg_base + inst.arg1); // add [rd], al
+                break;
+            case ADD_REG_IMM:
+                // add byte [rbx + rd], imm8
+                jit_emit_rbx_disp8(&b, 0x80, 0, reg_base + inst.arg1);
+                jit_emit8(&b, (uint8_t)inst.arg2);
+                break;
+            case CMP_REG_REG:
+                jit_emit_rbx_disp8(&b, 0x8A, 0, reg_base + inst.arg1); // mov al, [r1]
+                jit_emit_rbx_disp8(&b, 0x3A, 0, reg_base + inst.arg2); // cmp al, [r2]
+                jit_emit8(&b, 0x0F);                                   // sete [zf]
+                jit_emit_rbx_disp8(&b, 0x94, 0, zf);
+                break;
+            case JE_ADDR:
+                jit_emit_rbx_disp8(&b, 0x80, 7, zf);                   // cmp byte [zf], 0
+                jit_emit8(&b, 0x00);
+                jit_emit8(&b, 0x0F); jit_emit8(&b, 0x85);              // jne target
+                patches[patch_count].at = b.size;
+                patches[patch_count].target = inst.arg1;
+                patch_count++;
+                jit_emit32(&b, 0);
+                break;
+            case JMP_ADDR:
+                jit_emit8(&b, 0xE9);                                   // jmp target
+                patches[patch_count].at = b.size;
+                patches[patch_count].target = inst.arg1;
+                patch_count++;
+                jit_emit32(&b, 0);
+                break;
+            case LD_REG_REG:
+            case LD_REV_REG_REG:
+                {
+                    int dest = (inst.type == LD_REG_REG) ? inst.arg1 : inst.arg2;
+                    int addr = (inst.type == LD_REG_REG) ? inst.arg2 : inst.arg1;
+                    jit_emit8(&b, 0x0F);                               // movzx esi, [ra]
+                    jit_emit_rbx_disp8(&b, 0xB6, 6, reg_base + addr);
+                    jit_emit8(&b, 0x8A); jit_emit8(&b, 0x44);          // mov al, [rbp + rsi]
+                    jit_emit8(&b, 0x35); jit_emit8(&b, 0x00);
+                    jit_emit_rbx_disp8(&b, 0x88, 0, reg_base + dest);  // mov [rd], al
+                    jit_emit_memory_access(&b, &ctx->options);
+                }
+                break;
+            case ST_REG_REG:
+                jit_emit8(&b, 0x0F);                                   // movzx esi, [ra]
+                jit_emit_rbx_disp8(&b, 0xB6, 6, reg_base + inst.arg1);
+                jit_emit_rbx_disp8(&b, 0x8A, 0, reg_base + inst.arg2); // mov al, [rs]
+                jit_emit8(&b, 0x88); jit_emit8(&b, 0x44);              // mov [rbp + rsi], al
+                jit_emit8(&b, 0x35); jit_emit8(&b, 0x00);
+                jit_emit_memory_access(&b, &ctx->options);
+                break;
+            case INVALID:
+                // counted by the block prologue, no code
+                break;
+            default:
+                // superinstructions are never fused before translation
+                break;
+        }
+    }
+    
+    // epilogue: falling off the end or leaving the program lands here
+    offsets[end] = b.size;
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0xB8); jit_emit64(&b, (uint64_t)(uintptr_t)&ctx->jit_counters); // mov rax
+    jit_emit8(&b, 0x4C); jit_emit8(&b, 0x89); jit_emit8(&b, 0x20);                   // mov [rax], r12
+    jit_emit8(&b, 0x4C); jit_emit8(&b, 0x89); jit_emit8(&b, 0x68); jit_emit8(&b, 8);  // mov [rax+8], r13
+    jit_emit8(&b, 0x4C); jit_emit8(&b, 0x89); jit_emit8(&b, 0x70); jit_emit8(&b, 16); // mov [rax+16], r14
+    jit_emit8(&b, 0x4C); jit_emit8(&b, 0x89); jit_emit8(&b, 0x78); jit_emit8(&b, 24); // mov [rax+24], r15
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0x83); jit_emit8(&b, 0xC4); jit_emit8(&b, 0x08); // add rsp, 8
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x5F);               // pop r15
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x5E);               // pop r14
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x5D);               // pop r13
+    jit_emit8(&b, 0x41); jit_emit8(&b, 0x5C);               // pop r12
+    jit_emit8(&b, 0x5D);                                    // pop rbp
+    jit_emit8(&b, 0x5B);                                    // pop rbx
+    jit_emit8(&b, 0xC3);                                    // ret
+    
+    // budget exit: flag the early stop, then the epilogue
+    size_t budget_exit = b.size;
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0xB8); jit_emit64(&b, (uint64_t)(uintptr_t)&ctx->jit_counters); // mov rax
+    jit_emit8(&b, 0x48); jit_emit8(&b, 0xC7); jit_emit8(&b, 0x40); jit_emit8(&b, 32); jit_emit32(&b, 1); // mov qword [rax+32], 1
+    jit_emit8(&b, 0xE9);                                    // jmp epilogue
+    jit_emit32(&b, (uint32_t)(int32_t)((int64_t)offsets[end] - (int64_t)(b.size + 4)));
+    
+    // resolve branches, targets outside the program exit
+    for (int p = 0; p < patch_count; p++) {
+        int target = patches[p].target;
+        size_t dest = patches[p].budget ? budget_exit :
+                      (target >= 0 && target < end) ? offsets[target] : offsets[end];
+        int32_t rel = (int32_t)((int64_t)dest - (int64_t)(patches[p].at + 4));
+        memcpy(b.code + patches[p].at, &rel, 4);
+    }
+    
+    free(offsets);
+    free(patches);
+    
+    // W^X: the buffer is never writable and executable at the same time
+    if (mprotect(b.code, b.capacity, PROT_READ | PROT_EXEC) != 0) {
+        munmap(b.code, b.capacity);
+        return -1;
+    }
+    ctx->jit_code = b.code;
+    ctx->jit_code_size = b.capacity;
+    return 0;
+}
+
+static void jit_free(IssContext* ctx) {
+    if (ctx->jit_code) {
+        munmap(ctx->jit_code, ctx->jit_code_size);
+        ctx->jit_code = NULL;
+    }
+}
+
+static void jit_run(IssContext* ctx) {
+    void (*entry)(void);
+    memcpy(&entry, &ctx->jit_code, sizeof(entry));
+    memset(&ctx->jit_counters, 0, sizeof(ctx->jit_counters));
+    entry();
+}
+#endif
+
+// trace hooks of the interpreters, out of line so the untraced hot paths
+// keep their size
+__attribute__((noinline, cold)) static void trace_memory(TraceWriter* trace, uint8_t addr, int hit) {
+    trace_access(trace, addr, hit);
+}
+
+__attribute__((noinline, cold)) static void trace_enter(TraceWriter* trace, const BasicBlock* blocks, int pc) {
+    trace_block(trace, pc, blocks[pc].end, blocks[pc].cycles, blocks[pc].memory_ops);
+}
+
+// a stop line inside a counted loop has to see every iteration
+static int loop_covers(const LoopSummary* summary, int pc) {
+    return pc >= summary->head && pc <= summary->tail;
+}
+
+// Execute the loaded program from the leader at start, counting on from
+// ctx->stats
+static void iss_execute(IssContext* ctx, int start) {
+    long long executed_instructions = ctx->stats.executed_instructions;
+    long long clock_cycles = ctx->stats.clock_cycles;
+    long long local_memory_hits = ctx->stats.local_memory_hits;
+    long long total_memory_hits = ctx->stats.memory_instructions;
+    long long start_instructions = executed_instructions;
+    int stopped = 0;
+    int budget_exhausted = 0;
+    int resume_pc = RUN_HALTED;
+    
+    // latencies are run-time options, kept in locals for the hot loops
+    int hit_cycles = ctx->options.hit_cycles;
+    int miss_cycles = ctx->options.miss_cycles;
+    // the budget is compared once per block, without one the limits are
+    // LLONG_MAX and the compare is never taken
+    long long max_instructions = ctx->options.max_instructions > 0 ? ctx->options.max_instructions : LLONG_MAX;
+    long long max_cycles = ctx->options.max_cycles > 0 ? ctx->options.max_cycles : LLONG_MAX;
+#define OVER_BUDGET() (executed_instructions >= max_instructions || clock_cycles >= max_cycles)
+    // the block the run starts at only stops it once control comes back
+    int stop_pc = ctx->options.stop_pc;
+#define AT_STOP(pc) ((pc) == stop_pc && executed_instructions > start_instructions)
+    // a trace sees every block entry and LD/ST, so loops are not fast-forwarded
+    TraceWriter* trace = ctx->trace;
+#define TRACE_BLOCK(pc) \
+    do { \
+        if (__builtin_expect(trace != NULL, 0)) { \
+            trace_enter(trace, ctx->blocks, pc); \
+        } \
+    } while (0)
+    
+#ifdef THREADED_DISPATCH
+    // label addresses only exist inside this function, so the handler
+    // pointers are patched in here once before the run
+    static const void* const dispatch_table[] = {
+        [MOV_REG_IMM] = &&op_mov_reg_imm,
+        [MOV_REG_REG] = &&op_mov_reg_reg,
+        [ADD_REG_REG] = &&op_add_reg_reg,
+        [ADD_REG_IMM] = &&op_add_reg_imm,
+        [CMP_REG_REG] = &&op_cmp_reg_reg,
+        [JE_ADDR] = &&op_je_addr,
+        [JMP_ADDR] = &&op_jmp_addr,
+        [LD_REG_REG] = &&op_ld_reg_reg,
+        [ST_REG_REG] = &&op_st_reg_reg,
+        [LD_REV_REG_REG] = &&op_ld_rev_reg_reg,
+        [INVALID] = &&op_invalid,
+        [CMP_JE] = &&op_cmp_je,
+        [CMP_JE_JMP] = &&op_cmp_je_jmp,
+        [ADD_IMM_ADD_IMM] = &&op_add_imm_add_imm,
+        [ADD_REG_ADD_IMM] = &&op_add_reg_add_imm,
+        [LD_ADD_IMM] = &&op_ld_add_imm,
+        [LD_ADD_REG] = &&op_ld_add_reg
+    };
+    // without a budget, stop line or trace leaders dispatch straight to
+    // their handler, otherwise they go through op_block first
+    int budget = ctx->options.max_instructions > 0 || ctx->options.max_cycles > 0 || stop_pc >= 0;
+    int end = ctx->instruction_count + ctx->first_line_number;
+    for (int i = 0; i < end; i++) {
+        ctx->threaded_code[i].handler = dispatch_table[ctx->threaded_code[i].type];
+        if (ctx->threaded_code[i].loop >= 0) {
+            ctx->threaded_code[i].head_handler = ctx->threaded_code[i].handler;
+            ctx->threaded_code[i].handler = &&op_loop_entry;
+        }
+        if ((budget || trace) && is_block_leader(ctx, i)) {
+            ctx->threaded_code[i].block_handler = ctx->threaded_code[i].handler;
+            ctx->threaded_code[i].handler = &&op_block;
+        }
+    }
+    ctx->threaded_code[end].handler = &&op_halt;
+    
+    const ThreadedInstruction* ip = &ctx->threaded_code[start];
+    uint8_t addr;
+    LoopOutcome loop_outcome;
+    
+#define DISPATCH() goto *ip->handler
+#define NEXT(c) do { executed_instructions++; clock_cycles += (c); ip++; DISPATCH(); } while (0)
+#define MEMORY_ACCESS(a) \
+    do { \
+        int hit = is_local_memory_hit(ctx, a); \
+        if (!hit) { \
+            clock_cycles += miss_cycles + 1; \
+        } else { \
+            local_memory_hits++; \
+            clock_cycles += hit_cycles + 1; \
+        } \
+        total_memory_hits++; \
+        if (__builtin_expect(trace != NULL, 0)) { \
+            trace_memory(trace, a, hit); \
+        } \
+    } while (0)
+    
+    DISPATCH();
+    
+op_mov_reg_imm:
+    ctx->cpu.registers[ip->arg1] = ip->arg2;
+    NEXT(1);
+op_mov_reg_reg:
+    ctx->cpu.registers[ip->arg1] = ctx->cpu.registers[ip->arg2];
+    NEXT(1);
+op_add_reg_reg:
+    ctx->cpu.registers[ip->arg1] += ctx->cpu.registers[ip->arg2];
+    NEXT(1);
+op_add_reg_imm:
+    ctx->cpu.registers[ip->arg1] += ip->arg2;
+    NEXT(1);
+op_cmp_reg_reg:
+    ctx->cpu.zero_flag = (ctx->cpu.registers[ip->arg1] == ctx->cpu.registers[ip->arg2]);
+    NEXT(1);
+op_je_addr:
+    executed_instructions++;
+    clock_cycles += 1;
+    ip = ctx->cpu.zero_flag ? ip->target : ip + 1;
+    DISPATCH();
+op_jmp_addr:
+    executed_instructions++;
+    clock_cycles += 1;
+    ip = ip->target;
+    DISPATCH();
+op_ld_reg_reg:
+    addr = (uint8_t)ctx->cpu.registers[ip->arg2];
+    MEMORY_ACCESS(addr);
+    ctx->cpu.registers[ip->arg1] = ctx->memory.memory[addr];
+    NEXT(0);
+op_ld_rev_reg_reg:
+    addr = (uint8_t)ctx->cpu.registers[ip->arg1];
+    MEMORY_ACCESS(addr);
+    ctx->cpu.registers[ip->arg2] = ctx->memory.memory[addr];
+    NEXT(0);
+op_st_reg_reg:
+    addr = (uint8_t)ctx->cpu.registers[ip->arg1];
+    MEMORY_ACCESS(addr);
+    ctx->memory.memory[addr] = (uint8_t)ctx->cpu.registers[ip->arg2];
+    NEXT(0);
+op_invalid:
+    // Skip invalid instructions
+    NEXT(0);
+    
+    // superinstructions, accounted exactly like the unfused sequence
+op_cmp_je:
+    ctx->cpu.zero_flag = (ctx->cpu.registers[ip->arg1] == ctx->cpu.registers[ip->arg2]);
+    executed_instructions += 2;
+    clock_cycles += 2;
+    ctx->fusion_saved_dispatches++;
+    ip = ctx->cpu.zero_flag ? ip->target : ip + 2;
+    DISPATCH();
+op_cmp_je_jmp:
+    ctx->cpu.zero_flag = (ctx->cpu.registers[ip->arg1] == ctx->cpu.registers[ip->arg2]);
+    executed_instructions += 2;
+    clock_cycles += 2;
+    ctx->fusion_saved_dispatches++;
+    if (ctx->cpu.zero_flag) {
+        ip = ip->target;
+        DISPATCH();
+    }
+    // the JMP is a block of its own
+    if (budget && (OVER_BUDGET() || AT_STOP((int)(ip - ctx->threaded_code) + 2))) {
+        stopped = 1;
+        ip += 2;
+        goto op_halt;
+    }
+    TRACE_BLOCK((int)(ip - ctx->threaded_code) + 2);
+    executed_instructions++;
+    clock_cycles++;
+    ctx->fusion_saved_dispatches++;
+    ip = ip->target2;
+    DISPATCH();
+op_add_imm_add_imm:
+    ctx->cpu.registers[ip->arg1] += ip->arg2;
+    ctx->cpu.registers[ip->arg3] += ip->arg4;
+    ctx->fusion_saved_dispatches++;
+    executed_instructions++;
+    clock_cycles += 1;
+    ip++;
+    NEXT(1);
+op_add_reg_add_imm:
+    ctx->cpu.registers[ip->arg1] += ctx->cpu.registers[ip->arg2];
+    ctx->cpu.registers[ip->arg3] += ip->arg4;
+    ctx->fusion_saved_dispatches++;
+    executed_instructions++;
+    clock_cycles += 1;
+    ip++;
+    NEXT(1);
+op_ld_add_imm:
+    addr = (uint8_t)ctx->cpu.registers[ip->arg2];
+    MEMORY_ACCESS(addr);
+    ctx->cpu.registers[ip->arg1] = ctx->memory.memory[addr];
+    ctx->cpu.registers[ip->arg3] += ip->arg4;
+    ctx->fusion_saved_dispatches++;
+    executed_instructions++;
+    ip++;
+    NEXT(1);
+op_ld_add_reg:
+    addr = (uint8_t)ctx->cpu.registers[ip->arg2];
+    MEMORY_ACCESS(addr);
+    ctx->cpu.registers[ip->arg1] = ctx->memory.memory[addr];
+    ctx->cpu.registers[ip->arg3] += ctx->cpu.registers[ip->arg4];
+    ctx->fusion_saved_dispatches++;
+    executed_instructions++;
+    ip++;
+    NEXT(1);
+op_loop_entry:
+    if (trace || loop_covers(&ctx->loops[ip->loop], stop_pc) ||
+        !fast_forward_loop(ctx, &ctx->loops[ip->loop], max_instructions - executed_instructions,
+                                    max_cycles - clock_cycles, &loop_outcome)) {
+        goto *ip->head_handler;
+    }
+    executed_instructions += loop_outcome.instructions;
+    clock_cycles += loop_outcome.cycles;
+    local_memory_hits += loop_outcome.hits;
+    total_memory_hits += loop_outcome.memory_ops;
+    ip = (loop_outcome.exit_target >= 0 && loop_outcome.exit_target < end) ?
+         &ctx->threaded_code[loop_outcome.exit_target] : &ctx->threaded_code[end];
+    DISPATCH();
+op_block:
+    if (OVER_BUDGET() || AT_STOP((int)(ip - ctx->threaded_code))) {
+        stopped = 1;
+        goto op_halt;
+    }
+    TRACE_BLOCK((int)(ip - ctx->threaded_code));
+    goto *ip->block_handler;
+op_halt:
+    if (stopped) {
+        resume_pc = (int)(ip - ctx->threaded_code);
+    }
+    
+#undef MEMORY_ACCESS
+#undef NEXT
+#undef DISPATCH
+#else
+    // Execute block by block: a block's static counts are added on entry,
+    // inside it only LD/ST add their cache latency. Falling off the end of a
+    // block leaves i at the next leader, taken branches set i and restart.
+    int end = ctx->instruction_count + ctx->first_line_number;
+    int i = start;
+#ifdef ISS_PROFILE
+#define PROFILE_BLOCK(pc) (ctx->profile[pc].block_runs++)
+#define PROFILE_MISS(pc) (ctx->profile[pc].misses++)
+#else
+#define PROFILE_BLOCK(pc) ((void)0)
+#define PROFILE_MISS(pc) ((void)0)
+#endif
+    // cache latency of the LD/ST at i, the block entry counted the rest
+#define MEMORY_ACCESS(a) \
+    do { \
+        int hit = is_local_memory_hit(ctx, a); \
+        if (!hit) { \
+            clock_cycles += miss_cycles; \
+            PROFILE_MISS(i); \
+        } else { \
+            local_memory_hits++; \
+            clock_cycles += hit_cycles; \
+        } \
+        if (__builtin_expect(trace != NULL, 0)) { \
+            trace_memory(trace, a, hit); \
+        } \
+    } while (0)
+next_block:
+    while (i >= 0 && i < end) {
+        if (OVER_BUDGET() || AT_STOP(i)) {
+            stopped = 1;
+            resume_pc = i;
+            break;
+        }
+        const BasicBlock* block = &ctx->blocks[i];
+        PROFILE_BLOCK(i);
+        TRACE_BLOCK(i);
+        executed_instructions += block->instructions;
+        clock_cycles += block->cycles;
+        total_memory_hits += block->memory_ops;
+        // local, the int8_t register stores may alias anything in memory
+        int block_end = block->end;
+        
+        for (; i < block_end; i++) {
+            Instruction inst = ctx->instructions[i];
+            
+        dispatch:
+            switch (inst.type) {
+                case MOV_REG_IMM:
+                    ctx->cpu.registers[inst.arg1] = inst.arg2;
+                    break;
+                    
+                case MOV_REG_REG:
+                    ctx->cpu.registers[inst.arg1] = ctx->cpu.registers[inst.arg2];
+                    break;
+                    
+                case ADD_REG_REG:
+                    ctx->cpu.registers[inst.arg1] += ctx->cpu.registers[inst.arg2];
+                    break;
+                    
+                case ADD_REG_IMM:
+                    ctx->cpu.registers[inst.arg1] += inst.arg2;
+                    break;
+                    
+                case CMP_REG_REG:
+                    ctx->cpu.zero_flag = (ctx->cpu.registers[inst.arg1] == ctx->cpu.registers[inst.arg2]);
+                    break;
+                    
+                case JE_ADDR:
+                    if (ctx->cpu.zero_flag) {
+                        i = inst.arg1;
+                        goto next_block;
+                    }
+                    break;
+                    
+                case JMP_ADDR:
+                    i = inst.arg1;
+                    goto next_block;
+                    
+                case LD_REG_REG:
+                    {
+                        uint8_t addr = (uint8_t)ctx->cpu.registers[inst.arg2];
+                        MEMORY_ACCESS(addr);
+                        ctx->cpu.registers[inst.arg1] = ctx->memory.memory[addr];
+                    }
+                    break;
+                    
+                case LD_REV_REG_REG:
+                    {
+                        uint8_t addr = (uint8_t)ctx->cpu.registers[inst.arg1];
+                        MEMORY_ACCESS(addr);
+                        ctx->cpu.registers[inst.arg2] = ctx->memory.memory[addr];
+                    }
+                    break;
+                    
+                case ST_REG_REG:
+                    {
+                        uint8_t addr = (uint8_t)ctx->cpu.registers[inst.arg1];
+                        MEMORY_ACCESS(addr);
+                        ctx->memory.memory[addr] = (uint8_t)ctx->cpu.registers[inst.arg2];
+                    }
+                    break;
+                    
+                case INVALID:
+                    // Skip invalid instructions
+                    break;
+                    
+                // superinstructions, the block totals already cover every
+                // record they replace except the trailing JMP's own block
+                case CMP_JE:
+                    ctx->cpu.zero_flag = (ctx->cpu.registers[inst.arg1] == ctx->cpu.registers[inst.arg2]);
+                    ctx->fusion_saved_dispatches++;
+                    if (ctx->cpu.zero_flag) {
+                        i = inst.arg3;
+                        goto next_block;
+                    }
+                    i++;
+                    break;
+                    
+                case CMP_JE_JMP:
+                    ctx->cpu.zero_flag = (ctx->cpu.registers[inst.arg1] == ctx->cpu.registers[inst.arg2]);
+                    if (ctx->cpu.zero_flag) {
+                        ctx->fusion_saved_dispatches++;
+                        i = inst.arg3;
+                    } else if (OVER_BUDGET() || AT_STOP(i + 2)) {
+                        // the JMP is a block of its own
+                        stopped = 1;
+                        resume_pc = i + 2;
+                        goto run_stopped;
+                    } else {
+                        PROFILE_BLOCK(i + 2);
+                        TRACE_BLOCK(i + 2);
+                        executed_instructions++;
+                        clock_cycles++;
+                        ctx->fusion_saved_dispatches += 2;
+                        i = inst.arg4;
+                    }
+                    goto next_block;
+                    
+                case ADD_IMM_ADD_IMM:
+                    ctx->cpu.registers[inst.arg1] += inst.arg2;
+                    ctx->cpu.registers[inst.arg3] += inst.arg4;
+                    ctx->fusion_saved_dispatches++;
+                    i++;
+                    break;
+                    
+                case ADD_REG_ADD_IMM:
+                    ctx->cpu.registers[inst.arg1] += ctx->cpu.registers[inst.arg2];
+                    ctx->cpu.registers[inst.arg3] += inst.arg4;
+                    ctx->fusion_saved_dispatches++;
+                    i++;
+                    break;
+                    
+                case LD_ADD_IMM:
+                case LD_ADD_REG:
+                    {
+                        uint8_t addr = (uint8_t)ctx->cpu.registers[inst.arg2];
+                        MEMORY_ACCESS(addr);
+                        ctx->cpu.registers[inst.arg1] = ctx->memory.memory[addr];
+                        if (inst.type == LD_ADD_IMM) {
+                            ctx->cpu.registers[inst.arg3] += inst.arg4;
+                        } else {
+                            ctx->cpu.registers[inst.arg3] += ctx->cpu.registers[inst.arg4];
+                        }
+                        ctx->fusion_saved_dispatches++;
+                        i++;
+                    }
+                    break;
+                    
+                case LOOP_ENTRY:
+                    {
+                        // the outcome covers the head block added on entry
+                        LoopOutcome outcome;
+                        long long before_instructions = executed_instructions - block->instructions;
+                        long long before_cycles = clock_cycles - block->cycles;
+                        if (trace || loop_covers(&ctx->loops[inst.arg1], stop_pc) ||
+                            !fast_forward_loop(ctx, &ctx->loops[inst.arg1],
+                                                        max_instructions - before_instructions,
+                                                        max_cycles - before_cycles, &outcome)) {
+                            inst = ctx->loops[inst.arg1].head_instruction;
+                            goto dispatch;
+                        }
+                        executed_instructions = before_instructions + outcome.instructions;
+                        clock_cycles = before_cycles + outcome.cycles;
+                        local_memory_hits += outcome.hits;
+                        total_memory_hits += outcome.memory_ops - block->memory_ops;
+                        i = outcome.exit_target;
+                        goto next_block;
+                    }
+            }
+        }
+    }
+run_stopped:
+    
+#undef MEMORY_ACCESS
+#undef PROFILE_MISS
+#undef PROFILE_BLOCK
+#endif
+    budget_exhausted = stopped && OVER_BUDGET();
+#undef AT_STOP
+#undef TRACE_BLOCK
+#undef OVER_BUDGET
+    
+    if (trace) {
+        trace_end_run(trace, executed_instructions, clock_cycles, local_memory_hits, total_memory_hits,
+                      budget_exhausted);
+    }    
+    ctx->stats.executed_instructions = executed_instructions;
+    ctx->stats.clock_cycles = clock_cycles;
+    ctx->stats.local_memory_hits = local_memory_hits;
+    ctx->stats.memory_instructions = total_memory_hits;
+    ctx->stats.budget_exhausted = budget_exhausted;
+    ctx->stats.stopped_at_pc = stopped && !budget_exhausted;
+    ctx->resume_pc = resume_pc;
+}
+
+// Execute the loaded program
+void iss_run(IssContext* ctx) {
+    // Initialize registers
+    for (int i = 1; i < 7; i++) {
+        ctx->cpu.registers[i] = 0;
+    }
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    
+#ifdef JIT_BACKEND
+    if (ctx->jit_code && !ctx->trace && ctx->options.stop_pc < 0) {
+        jit_run(ctx);
+        ctx->stats.executed_instructions = (long long)ctx->jit_counters.executed;
+        ctx->stats.clock_cycles = (long long)ctx->jit_counters.cycles;
+        ctx->stats.local_memory_hits = (long long)ctx->jit_counters.hits;
+        ctx->stats.memory_instructions = (long long)ctx->jit_counters.memory_ops;
+        ctx->stats.budget_exhausted = ctx->jit_counters.budget_exhausted != 0;
+        ctx->resume_pc = ctx->stats.budget_exhausted ? RUN_UNRESUMABLE : RUN_HALTED;
+        return;
+    }
+#endif
+#ifdef ISS_PROFILE
+    memset(ctx->profile, 0, ((size_t)(ctx->instruction_count + ctx->first_line_number) + 1) * sizeof(ProfileCounter));
+#endif
+    iss_execute(ctx, ctx->first_line_number);
+}
+
+int iss_resume(IssContext* ctx) {
+    if (!ctx->instructions) {
+        fprintf(stderr, "Error: no program loaded\n");
+        return -1;
+    }
+    if (ctx->resume_pc == RUN_UNRESUMABLE) {
+        fprintf(stderr, "Error: the run stopped in generated code, which keeps no pc to resume from\n");
+        return -1;
+    }
+    if (ctx->trace) {
+        fprintf(stderr, "Error: a traced run cannot be resumed\n");
+        return -1;
+    }
+    if (ctx->resume_pc != RUN_HALTED) {
+        iss_execute(ctx, ctx->resume_pc);
+    }
+    return 0;
+}
+
+// SIMD lanes: the same decoded program over up to ISS_MAX_LANES initial
+// states in lockstep. Register Rn of every lane is one byte vector (GCC
+// vector extension, AVX2 or SSE2 registers depending on -march), so a
+// register operation runs all lanes in one instruction. Lanes that agree on
+// the pc form a group with a 0/-1 byte mask that blends results into just
+// its lanes. A JE splits a group when its lanes disagree, and groups that
+// reach the same leader merge again. The group with the lowest pc runs
+// next, which brings diverged lanes back together at the join point. Block
+// counts are kept per group and only spread over its lanes on a split, merge
+// or halt. LD/ST touch lanes one by one, each lane has its own memory and
+// cache.
+typedef int8_t LaneVector __attribute__((vector_size(ISS_MAX_LANES)));
+typedef int8_t LaneHalf __attribute__((vector_size(16)));
+typedef uint64_t LaneWords __attribute__((vector_size(ISS_MAX_LANES)));
+
+typedef struct {
+    LaneVector mask;
+    int pc;
+    long long executed;    // block counts since the group formed
+    long long cycles;
+    long long memory_ops;
+} LaneGroup;
+
+typedef struct {
+    // rows 0-7 mirror CPU: R0 unused (zero), R1-R6, row 7 the zero flag
+    LaneVector registers[8];
+    LaneGroup groups[ISS_MAX_LANES];
+    int group_count;
+    IssStats* stats;
+    uint8_t memory[ISS_MAX_LANES][LOCAL_MEMORY_SIZE];
+    uint8_t touched[ISS_MAX_LANES][LOCAL_MEMORY_SIZE];
+    CacheModel* caches;    // one per lane when the cache model is enabled
+} LaneMachine;
+
+static int lanes_supported(const IssContext* ctx) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    for (int i = 0; i < end; i++) {
+        const Instruction* inst = &ctx->plain_instructions[i];
+        if (inst->type == ADD_REG_REG && !register_operand_ok(inst->arg2)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int lane_mask_empty(const LaneVector* mask) {
+    LaneWords words = (LaneWords)*mask;
+    uint64_t any = 0;
+    for (int w = 0; w < ISS_MAX_LANES / 8; w++) {
+        any |= words[w];
+    }
+    return any == 0;
+}
+
+// CMP for the lanes in mask. Compared in 16-byte halves: GCC turns a wider
+// vector compare into byte-by-byte code when the target lacks AVX2.
+static void lane_compare(LaneVector* flag, const LaneVector* a, const LaneVector* b, const LaneVector* mask) {
+    LaneHalf* f = (LaneHalf*)flag;
+    const LaneHalf* x = (const LaneHalf*)a;
+    const LaneHalf* y = (const LaneHalf*)b;
+    const LaneHalf* k = (const LaneHalf*)mask;
+    for (int h = 0; h < ISS_MAX_LANES / 16; h++) {
+        f[h] = (f[h] & ~k[h]) | ((x[h] == y[h]) & k[h] & 1);
+    }
+}
+
+// add a group's block counts to each of its lanes
+static void lane_group_flush(LaneMachine* m, LaneGroup* group) {
+    for (int l = 0; l < ISS_MAX_LANES; l++) {
+        if (group->mask[l]) {
+            m->stats[l].executed_instructions += group->executed;
+            m->stats[l].clock_cycles += group->cycles;
+            m->stats[l].memory_instructions += group->memory_ops;
+        }
+    }
+    group->executed = 0;
+    group->cycles = 0;
+    group->memory_ops = 0;
+}
+
+// stop the lanes of group g that have reached the budget at this block
+// entry. Lanes of one group can have different totals, so each is checked
+// on its own. Returns 0 when the whole group stopped and was removed.
+static int lane_group_budget(const IssOptions* options, LaneMachine* m, int g) {
+    LaneGroup* group = &m->groups[g];
+    long long max_instructions = options->max_instructions > 0 ? options->max_instructions : LLONG_MAX;
+    long long max_cycles = options->max_cycles > 0 ? options->max_cycles : LLONG_MAX;
+    
+    lane_group_flush(m, group);
+    for (int l = 0; l < ISS_MAX_LANES; l++) {
+        if (group->mask[l] && (m->stats[l].executed_instructions >= max_instructions ||
+                               m->stats[l].clock_cycles >= max_cycles)) {
+            group->mask[l] = 0;
+            m->stats[l].budget_exhausted = 1;
+        }
+    }
+    if (lane_mask_empty(&group->mask)) {
+        *group = m->groups[--m->group_count];
+        return 0;
+    }
+    return 1;
+}
+
+// one LD/ST for every lane in mask
+static void lane_memory_access(IssContext* ctx, LaneMachine* m, const LaneVector* mask, const Instruction* inst) {
+    int hit_cycles = ctx->options.hit_cycles;
+    int miss_cycles = ctx->options.miss_cycles;
+    int addr_reg = (inst->type == LD_REG_REG) ? inst->arg2 : inst->arg1;
+    
+    for (int l = 0; l < ISS_MAX_LANES; l++) {
+        if (!(*mask)[l]) {
+            continue;
+        }
+        uint8_t addr = (uint8_t)m->registers[addr_reg][l];
+        int hit;
+        if (m->caches) {
+            hit = cache_model_access(&m->caches[l], addr);
+        } else {
+            hit = m->touched[l][addr];
+            m->touched[l][addr] = 1;
+        }
+        if (hit) {
+            m->stats[l].local_memory_hits++;
+            m->stats[l].clock_cycles += hit_cycles;
+        } else {
+            m->stats[l].clock_cycles += miss_cycles;
+        }
+        switch (inst->type) {
+            case LD_REG_REG:
+                m->registers[inst->arg1][l] = (int8_t)m->memory[l][addr];
+                break;
+            case LD_REV_REG_REG:
+                m->registers[inst->arg2][l] = (int8_t)m->memory[l][addr];
+                break;
+            default:
+                m->memory[l][addr] = (uint8_t)m->registers[inst->arg2][l];
+                break;
+        }
+    }
+}
+
+// move group g to pc, halting it outside the program and merging it into
+// another group already there
+static void lane_group_move(LaneMachine* m, int g, int pc, int end) {
+    LaneGroup* group = &m->groups[g];
+    if (pc < 0 || pc >= end) {
+        lane_group_flush(m, group);
+        *group = m->groups[--m->group_count];
+        return;
+    }
+    group->pc = pc;
+    for (int other = 0; other < m->group_count; other++) {
+        if (other != g && m->groups[other].pc == pc) {
+            lane_group_flush(m, group);
+            lane_group_flush(m, &m->groups[other]);
+            m->groups[other].mask |= group->mask;
+            *group = m->groups[--m->group_count];
+            return;
+        }
+    }
+}
+
+// run the lanes of m until every one has halted
+static void lanes_run_group(IssContext* ctx, LaneMachine* m) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    int budget = ctx->options.max_instructions > 0 || ctx->options.max_cycles > 0;
+    LaneVector* r = m->registers;
+    
+    while (m->group_count > 0) {
+        int g = 0;
+        for (int other = 1; other < m->group_count; other++) {
+            if (m->groups[other].pc < m->groups[g].pc) {
+                g = other;
+            }
+        }
+        if (budget && !lane_group_budget(&ctx->options, m, g)) {
+            continue;
+        }
+        LaneGroup* group = &m->groups[g];
+        LaneVector mask = group->mask;
+        int i = group->pc;
+        const BasicBlock* block = &ctx->blocks[i];
+        group->executed += block->instructions;
+        group->cycles += block->cycles;
+        group->memory_ops += block->memory_ops;
+        
+        int next = block->end;
+        int target = 0;
+        LaneVector taken = {0};
+        for (int block_end = block->end; i < block_end; i++) {
+            const Instruction* inst = &ctx->plain_instructions[i];
+            switch (inst->type) {
+                case MOV_REG_IMM:
+                    r[inst->arg1] = (r[inst->arg1] & ~mask) | ((int8_t)inst->arg2 & mask);
+                    break;
+                case MOV_REG_REG:
+                    r[inst->arg1] = (r[inst->arg1] & ~mask) | (r[inst->arg2] & mask);
+                    break;
+                case ADD_REG_REG:
+                    r[inst->arg1] += r[inst->arg2] & mask;
+                    break;
+                case ADD_REG_IMM:
+                    r[inst->arg1] += (int8_t)inst->arg2 & mask;
+                    break;
+                case CMP_REG_REG:
+                    lane_compare(&r[7], &r[inst->arg1], &r[inst->arg2], &mask);
+                    break;
+                case JE_ADDR:
+                    // always the last record of its block, flags are 0/1
+                    taken = -r[7] & mask;
+                    target = inst->arg1;
+                    break;
+                case JMP_ADDR:
+                    taken = mask;
+                    target = inst->arg1;
+                    break;
+                case LD_REG_REG:
+                case LD_REV_REG_REG:
+                case ST_REG_REG:
+                    lane_memory_access(ctx, m, &mask, inst);
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        LaneVector stay = mask & ~taken;
+        if (lane_mask_empty(&taken)) {
+            lane_group_move(m, g, next, end);
+        } else if (lane_mask_empty(&stay)) {
+            lane_group_move(m, g, target, end);
+        } else {
+            // the lanes disagree, the taken ones leave as a new group. The
+            // old group is already past this block, so a branch back to the
+            // block's own leader doesn't merge the split straight back
+            lane_group_flush(m, group);
+            group->mask = stay;
+            LaneGroup* split = &m->groups[m->group_count++];
+            *split = *group;
+            split->mask = taken;
+            group->pc = next;
+            lane_group_move(m, m->group_count - 1, target, end);
+            lane_group_move(m, g, next, end);
+        }
+    }
+}
+
+int iss_run_lanes(IssContext* ctx, const IssLaneState* initial, int count, IssStats* stats) {
+    if (!ctx->plain_instructions || !lanes_supported(ctx)) {
+        fprintf(stderr, "Error: program not supported by the lane engine\n");
+        return -1;
+    }
+    LaneMachine* m = aligned_alloc(sizeof(LaneVector), sizeof(LaneMachine));
+    CacheModel* caches = NULL;
+    if (m && ctx->cache_model_enabled) {
+        caches = calloc(ISS_MAX_LANES, sizeof(CacheModel));
+    }
+    if (!m || (ctx->cache_model_enabled && !caches)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(m);
+        return -1;
+    }
+    
+    int end = ctx->instruction_count + ctx->first_line_number;
+    int result = 0;
+    for (int first = 0; first < count && result == 0; first += ISS_MAX_LANES) {
+        int lanes = count - first < ISS_MAX_LANES ? count - first : ISS_MAX_LANES;
+        memset(m, 0, sizeof(*m));
+        m->stats = &stats[first];
+        memset(m->stats, 0, (size_t)lanes * sizeof(IssStats));
+        for (int l = 0; l < lanes; l++) {
+            for (int reg = 1; reg <= 6; reg++) {
+                m->registers[reg][l] = initial[first + l].registers[reg - 1];
+            }
+            memcpy(m->memory[l], initial[first + l].memory, LOCAL_MEMORY_SIZE);
+            m->groups[0].mask[l] = -1;
+        }
+        if (ctx->first_line_number < end) {
+            m->groups[0].pc = ctx->first_line_number;
+            m->group_count = 1;
+        }
+        if (caches) {
+            for (int l = 0; l < lanes; l++) {
+                if (cache_model_init(&caches[l], &ctx->options.cache) != 0) {
+                    result = -1;
+                }
+            }
+            m->caches = caches;
+        }
+        if (result == 0) {
+            lanes_run_group(ctx, m);
+        }
+        if (caches) {
+            for (int l = 0; l < lanes; l++) {
+                cache_model_free(&caches[l]);
+            }
+        }
+    }
+    
+    free(caches);
+    free(m);
+    return result;
+}
+
+void iss_options_default(IssOptions* options) {
+    options->cache_model = 0;
+    cache_config_default(&options->cache);
+    options->hit_cycles = CACHE_HIT_CYCLES;
+    options->miss_cycles = CACHE_MISS_CYCLES;
+    options->fusion = 1;
+    options->fast_forward = 1;
+    options->jit = 1;
+    options->max_instructions = 0;
+    options->max_cycles = 0;
+    options->stop_pc = -1;
+}
+
+IssContext* iss_create(const IssOptions* options) {
+    IssContext* ctx = calloc(1, sizeof(IssContext));
+    if (!ctx) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    ctx->options = *options;
+    ctx->cache_model_enabled = options->cache_model;
+    if (ctx->cache_model_enabled && cache_model_init(&ctx->cache_model, &options->cache) != 0) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+// drop the loaded program and everything derived from it
+static void iss_unload(IssContext* ctx) {
+    if (ctx->trace && iss_trace_close(ctx) != 0) {
+        fprintf(stderr, "Warning: the execution trace could not be written completely\n");
+    }
+#ifdef THREADED_DISPATCH
+    free(ctx->threaded_code);
+    ctx->threaded_code = NULL;
+#endif
+#ifdef JIT_BACKEND
+    jit_free(ctx);
+#endif
+    if (ctx->binary.data) {
+        source_close(&ctx->binary);
+    } else {
+        free(ctx->plain_instructions);
+        free(ctx->blocks);
+    }
+    free(ctx->loops);
+    free(ctx->instructions);
+#ifdef ISS_PROFILE
+    free(ctx->profile);
+    ctx->profile = NULL;
+#endif
+    ctx->plain_instructions = NULL;
+    ctx->loops = NULL;
+    ctx->blocks = NULL;
+    ctx->instructions = NULL;
+    ctx->instruction_count = 0;
+    ctx->first_line_number = 0;
+    ctx->loop_count = 0;
+    ctx->program_checksum = 0;
+    memset(ctx->fusion_sites, 0, sizeof(ctx->fusion_sites));
+}
+
+void iss_destroy(IssContext* ctx) {
+    if (!ctx) {
+        return;
+    }
+    iss_unload(ctx);
+    if (ctx->cache_model_enabled) {
+        cache_model_free(&ctx->cache_model);
+    }
+    free(ctx);
+}
+
+// Build everything derived from the decoded program for this context's
+// options. plain_instructions is the decoded program, instructions the
+// copy the passes below rewrite.
+static int iss_prepare(IssContext* ctx) {
+    size_t records = (size_t)(ctx->instruction_count + ctx->first_line_number);
+    
+    ctx->fusion_enabled = ctx->options.fusion;
+    ctx->fast_forward_enabled = ctx->options.fast_forward;
+    ctx->instructions = malloc((records + 1) * sizeof(Instruction));
+    if (!ctx->instructions) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    memcpy(ctx->instructions, ctx->plain_instructions, records * sizeof(Instruction));
+#ifdef ISS_PROFILE
+    ctx->profile = calloc(records + 1, sizeof(ProfileCounter));
+    if (!ctx->profile) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+#endif
+    // a pre-assembled program brings its block table along
+    if (!ctx->blocks && build_basic_blocks(ctx) != 0) {
+        return -1;
+    }
+    
+#ifdef JIT_BACKEND
+    if (ctx->options.jit && jit_compile(ctx) != 0) {
+        fprintf(stderr, "Warning: JIT translation failed, using the interpreter\n");
+    }
+    // generated code already covers whole blocks, fusion and loop
+    // fast-forward are interpreter-only
+    if (ctx->jit_code) {
+        ctx->fusion_enabled = 0;
+        ctx->fast_forward_enabled = 0;
+    }
+#endif
+    if (ctx->fast_forward_enabled && find_counted_loops(ctx) != 0) {
+        return -1;
+    }
+    if (ctx->fusion_enabled) {
+        fuse_superinstructions(ctx);
+    }
+    if (ctx->fast_forward_enabled) {
+        install_loop_entries(ctx);
+    }
+#ifdef THREADED_DISPATCH
+    if (build_threaded_code(ctx) != 0) {
+        return -1;
+    }
+#endif
+    ctx->resume_pc = ctx->first_line_number;
+    return 0;
+}
+
+// Pre-assembled programs (.issbin): the decoded records and the basic-block
+// table exactly as they sit in memory, behind a versioned header, so loading
+// is a mapping plus a checksum pass. Records and blocks are host-native, a
+// file only loads on a host with the same byte order and struct layout.
+#define BINARY_MAGIC "ISSBIN\0\0"
+#define BINARY_VERSION 1
+#define BINARY_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // BINARY_BYTE_ORDER as the writer stored it
+    uint32_t record_size;       // sizeof(Instruction)
+    uint32_t block_size;        // sizeof(BasicBlock)
+    int32_t instruction_count;
+    int32_t first_line_number;  // records are indexed by line number
+    uint64_t records_offset;
+    uint64_t blocks_offset;
+    uint64_t payload_size;      // bytes after the header
+    uint64_t checksum;          // binary_checksum() of the payload
+} BinaryHeader;
+
+// FNV-1a over 8-byte words, the tail byte by byte
+static uint64_t binary_checksum(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static int is_binary_program(const SourceText* text) {
+    return text->size >= sizeof(BinaryHeader) && memcmp(text->data, BINARY_MAGIC, 8) == 0;
+}
+
+// a register operand the text parser accepts, R1-R6. ADD Rn, Rm reads its
+// second register unchecked, the engines address R0-R7 there
+static int binary_register_ok(int reg) {
+    return reg >= 1 && reg <= 6;
+}
+
+// The checksum only catches damage, so every record and block of a file is
+// checked once against what decoding the text would have produced before an
+// engine indexes anything with it: plain opcodes, register operands in range
+// and exactly the block table build_basic_blocks() builds.
+// returns 1 if the program is sound, 0 if not, -1 when out of memory
+static int binary_program_ok(const Instruction* program, const BasicBlock* blocks, int end, int first_line) {
+    for (int i = 0; i < end; i++) {
+        Instruction inst = program[i];
+        int ok = 1;
+        switch (inst.type) {
+            case MOV_REG_IMM:
+            case ADD_REG_IMM:
+                ok = binary_register_ok(inst.arg1);
+                break;
+            case ADD_REG_REG:
+                ok = binary_register_ok(inst.arg1) && inst.arg2 >= 0 && inst.arg2 <= 7;
+                break;
+            case MOV_REG_REG:
+            case CMP_REG_REG:
+            case LD_REG_REG:
+            case LD_REV_REG_REG:
+            case ST_REG_REG:
+                ok = binary_register_ok(inst.arg1) && binary_register_ok(inst.arg2);
+                break;
+            case JE_ADDR:
+            case JMP_ADDR:
+            case INVALID:
+                break;
+            default:
+                ok = 0;
+                break;
+        }
+        if (!ok) {
+            return 0;
+        }
+    }
+    
+    uint8_t* leader = calloc((size_t)end + 1, 1);
+    if (!leader) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    mark_block_leaders(program, end, first_line, leader);
+    int ok = blocks[end].end == 0;
+    for (int i = 0; i < end && ok; i++) {
+        const BasicBlock* block = &blocks[i];
+        if (!leader[i]) {
+            ok = block->end == 0 && block->instructions == 0 && block->cycles == 0 && block->memory_ops == 0;
+            continue;
+        }
+        // a leader's block runs up to the next leader, its totals summed over it
+        ok = block->end > i && block->end <= end && block->instructions == block->end - i;
+        int cycles = 0;
+        int memory_ops = 0;
+        for (int j = i; ok && j < block->end; j++) {
+            InstructionType type = program[j].type;
+            ok = j == i || !leader[j];
+            cycles += type != INVALID;
+            memory_ops += type == LD_REG_REG || type == LD_REV_REG_REG || type == ST_REG_REG;
+        }
+        ok = ok && (block->end == end || leader[block->end]) && block->cycles == cycles &&
+             block->memory_ops == memory_ops;
+    }
+    free(leader);
+    return ok;
+}
+
+// take over text's memory, plain_instructions and blocks point into it
+static int iss_load_binary(IssContext* ctx, SourceText* text) {
+    BinaryHeader header;
+    memcpy(&header, text->data, sizeof(header));
+    uint64_t records = (uint64_t)(int64_t)header.instruction_count + (uint64_t)(int64_t)header.first_line_number;
+    
+    if (header.version != BINARY_VERSION || header.byte_order != BINARY_BYTE_ORDER ||
+        header.record_size != sizeof(Instruction) || header.block_size != sizeof(BasicBlock)) {
+        fprintf(stderr, "Error: .issbin version or layout does not match this build, assemble it again\n");
+        return -1;
+    }
+    if (header.instruction_count < 0 || header.first_line_number < 0 || records > INT_MAX ||
+        header.payload_size != text->size - sizeof(header) ||
+        header.records_offset % 8 != 0 || header.blocks_offset % 8 != 0 ||
+        header.records_offset < sizeof(header) || header.blocks_offset < sizeof(header) ||
+        header.records_offset + records * sizeof(Instruction) > text->size ||
+        header.blocks_offset + (records + 1) * sizeof(BasicBlock) > text->size) {
+        fprintf(stderr, "Error: truncated or malformed .issbin file\n");
+        return -1;
+    }
+    if (binary_checksum((const uint8_t*)text->data + sizeof(header), (size_t)header.payload_size) != header.checksum) {
+        fprintf(stderr, "Error: .issbin checksum mismatch\n");
+        return -1;
+    }
+    int valid = binary_program_ok((const Instruction*)(text->data + header.records_offset),
+                                  (const BasicBlock*)(text->data + header.blocks_offset), (int)records,
+                                  header.first_line_number);
+    if (valid <= 0) {
+        if (valid == 0) {
+            fprintf(stderr, "Error: truncated or malformed .issbin file\n");
+        }
+        return -1;
+    }
+    
+    ctx->binary = *text;
+    memset(text, 0, sizeof(*text));
+    ctx->plain_instructions = (Instruction*)(ctx->binary.data + header.records_offset);
+    ctx->blocks = (BasicBlock*)(ctx->binary.data + header.blocks_offset);
+    ctx->instruction_count = header.instruction_count;
+    ctx->first_line_number = header.first_line_number;
+    return 0;
+}
+
+int iss_save_binary(const IssContext* ctx, const char* filename) {
+    if (!ctx->plain_instructions) {
+        fprintf(stderr, "Error: no program loaded\n");
+        return -1;
+    }
+    size_t records = (size_t)(ctx->instruction_count + ctx->first_line_number);
+    size_t records_size = (records * sizeof(Instruction) + 7) & ~(size_t)7;
+    size_t blocks_size = (records + 1) * sizeof(BasicBlock);
+    size_t payload_size = records_size + blocks_size;
+    uint8_t* payload = calloc(payload_size, 1);
+    if (!payload) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    memcpy(payload, ctx->plain_instructions, records * sizeof(Instruction));
+    memcpy(payload + records_size, ctx->blocks, blocks_size);
+    
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_MAGIC, 8);
+    header.version = BINARY_VERSION;
+    header.byte_order = BINARY_BYTE_ORDER;
+    header.record_size = sizeof(Instruction);
+    header.block_size = sizeof(BasicBlock);
+    header.instruction_count = ctx->instruction_count;
+    header.first_line_number = ctx->first_line_number;
+    header.records_offset = sizeof(header);
+    header.blocks_offset = sizeof(header) + records_size;
+    header.payload_size = payload_size;
+    header.checksum = binary_checksum(payload, payload_size);
+    
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        free(payload);
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(payload, 1, payload_size, file) == payload_size;
+    ok = (fclose(file) == 0) && ok;
+    free(payload);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// the decoded record in source syntax
+static void format_instruction(Instruction inst, char* text, size_t size) {
+    switch (inst.type) {
+        case MOV_REG_IMM: snprintf(text, size, "MOV R%d, %d", inst.arg1, inst.arg2); break;
+        case MOV_REG_REG: snprintf(text, size, "MOV R%d, R%d", inst.arg1, inst.arg2); break;
+        case ADD_REG_REG: snprintf(text, size, "ADD R%d, R%d", inst.arg1, inst.arg2); break;
+        case ADD_REG_IMM: snprintf(text, size, "ADD R%d, %d", inst.arg1, inst.arg2); break;
+        case CMP_REG_REG: snprintf(text, size, "CMP R%d, R%d", inst.arg1, inst.arg2); break;
+        case JE_ADDR: snprintf(text, size, "JE %d", inst.arg1); break;
+        case JMP_ADDR: snprintf(text, size, "JMP %d", inst.arg1); break;
+        case LD_REG_REG: snprintf(text, size, "LD R%d, [R%d]", inst.arg1, inst.arg2); break;
+        case LD_REV_REG_REG: snprintf(text, size, "LD [R%d], R%d", inst.arg1, inst.arg2); break;
+        case ST_REG_REG: snprintf(text, size, "ST [R%d], R%d", inst.arg1, inst.arg2); break;
+        default: snprintf(text, size, "(invalid)"); break;
+    }
+}
+
+// one C statement per record, in the register layout of CPU: r[7] aliases
+// zero_flag exactly as registers[7] does in the interpreter. Without any
+// LD nothing reads memory back, so stores only do the access
+static void emit_instruction(FILE* out, Instruction inst, int end, int has_loads) {
+    int target = (inst.arg1 >= 0 && inst.arg1 < end) ? inst.arg1 : -1;
+    switch (inst.type) {
+        case MOV_REG_IMM: fprintf(out, "r[%d] = (int8_t)%d;", inst.arg1, inst.arg2); break;
+        case MOV_REG_REG: fprintf(out, "r[%d] = r[%d];", inst.arg1, inst.arg2); break;
+        case ADD_REG_REG: fprintf(out, "r[%d] += r[%d];", inst.arg1, inst.arg2); break;
+        case ADD_REG_IMM: fprintf(out, "r[%d] += (int8_t)%d;", inst.arg1, inst.arg2); break;
+        case CMP_REG_REG: fprintf(out, "r[7] = r[%d] == r[%d];", inst.arg1, inst.arg2); break;
+        case JE_ADDR:
+            if (target >= 0) {
+                fprintf(out, "if (r[7]) goto L%d;", target);
+            } else {
+                fprintf(out, "if (r[7]) goto halt;");
+            }
+            break;
+        case JMP_ADDR:
+            if (target >= 0) {
+                fprintf(out, "goto L%d;", target);
+            } else {
+                fprintf(out, "goto halt;");
+            }
+            break;
+        case LD_REG_REG:
+        case LD_REV_REG_REG:
+            {
+                int dest = (inst.type == LD_REG_REG) ? inst.arg1 : inst.arg2;
+                int addr = (inst.type == LD_REG_REG) ? inst.arg2 : inst.arg1;
+                fprintf(out, "{ uint8_t a = (uint8_t)r[%d]; ACCESS(a); r[%d] = (int8_t)memory[a]; }", addr, dest);
+            }
+            break;
+        case ST_REG_REG:
+            if (has_loads) {
+                fprintf(out, "{ uint8_t a = (uint8_t)r[%d]; ACCESS(a); memory[a] = (uint8_t)r[%d]; }",
+                        inst.arg1, inst.arg2);
+            } else {
+                fprintf(out, "ACCESS((uint8_t)r[%d]);", inst.arg1);
+            }
+            break;
+        default:
+            fprintf(out, ";");
+            break;
+    }
+}
+
+int iss_emit_c(const IssContext* ctx, const char* filename) {
+    if (!ctx->plain_instructions) {
+        fprintf(stderr, "Error: no program loaded\n");
+        return -1;
+    }
+    int end = ctx->instruction_count + ctx->first_line_number;
+    const Instruction* program = ctx->plain_instructions;
+    long long memory_ops = 0;
+    int has_loads = 0;
+    for (int i = 0; i < end; i++) {
+        if (!instruction_registers_ok(program[i])) {
+            fprintf(stderr, "Error: line %d uses a register outside R0-R7, not translated\n", i);
+            return -1;
+        }
+        if (is_block_leader(ctx, i)) {
+            memory_ops += ctx->blocks[i].memory_ops;
+        }
+        has_loads |= program[i].type == LD_REG_REG || program[i].type == LD_REV_REG_REG;
+    }
+
+    // only branch targets and the entry get labels, other leaders fall through
+    uint8_t* labeled = calloc((size_t)end + 1, 1);
+    if (!labeled) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    labeled[ctx->first_line_number] = 1;
+    for (int i = 0; i < end; i++) {
+        if ((program[i].type == JE_ADDR || program[i].type == JMP_ADDR) && program[i].arg1 >= 0 &&
+            program[i].arg1 < end) {
+            labeled[program[i].arg1] = 1;
+        }
+    }
+
+    FILE* out = fopen(filename, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        free(labeled);
+        return -1;
+    }
+    const IssOptions* options = &ctx->options;
+    int budget = options->max_instructions > 0 || options->max_cycles > 0;
+    fprintf(out, "// Generated by myISS --emit-c. Block totals are added on entry and LD/ST\n");
+    fprintf(out, "// add their latency, so the counters match the interpreter exactly.\n");
+    fprintf(out, "// Build: cc -O2 -o program %s%s\n\n", filename, ctx->cache_model_enabled ? " cache.c" : "");
+    fprintf(out, "#include <stdio.h>\n#include <stdint.h>\n");
+    if (ctx->cache_model_enabled) {
+        fprintf(out, "\n#include \"cache.h\"\n");
+    }
+    fprintf(out, "\n#define HIT_CYCLES %d\n#define MISS_CYCLES %d\n\n", options->hit_cycles, options->miss_cycles);
+    fprintf(out, "typedef struct {\n    long long executed_instructions;\n    long long clock_cycles;\n"
+                 "    long long local_memory_hits;\n    long long memory_instructions;\n"
+                 "    int budget_exhausted;\n} ProgramStats;\n\n");
+    if (ctx->cache_model_enabled) {
+        fprintf(out, "static CacheModel cache;\n\n");
+    }
+    fprintf(out, "static void run_program(ProgramStats* stats) {\n");
+    fprintf(out, "    // r[1]-r[6] are R1-R6, r[7] is the zero flag, some programs never read one back\n"
+                 "    int8_t r[8] = {0};\n    (void)r;\n");
+    fprintf(out, "    long long instructions = 0, cycles = 0, hits = 0, memory_ops = 0;\n");
+    if (budget) {
+        fprintf(out, "    int budget_exhausted = 0;\n");
+    }
+    if (has_loads) {
+        fprintf(out, "    uint8_t memory[256] = {0};\n");
+    }
+    if (memory_ops > 0) {
+        if (ctx->cache_model_enabled) {
+            fprintf(out, "#define HIT(a) cache_model_access(&cache, a)\n");
+        } else {
+            fprintf(out, "    uint8_t touched[256] = {0};\n");
+            fprintf(out, "#define HIT(a) (touched[a] ? 1 : (touched[a] = 1, 0))\n");
+        }
+        fprintf(out, "#define ACCESS(a) \\\n    do { \\\n        if (HIT(a)) { \\\n            hits++; \\\n"
+                     "            cycles += HIT_CYCLES; \\\n        } else { \\\n"
+                     "            cycles += MISS_CYCLES; \\\n        } \\\n    } while (0)\n");
+    }
+    if (ctx->first_line_number < end) {
+        fprintf(out, "    goto L%d;\n", ctx->first_line_number);
+    } else {
+        fprintf(out, "    goto halt;\n");
+    }
+    for (int i = 0; i < end; i++) {
+        if (labeled[i]) {
+            fprintf(out, "L%d:\n", i);
+        }
+        if (is_block_leader(ctx, i)) {
+            const BasicBlock* block = &ctx->blocks[i];
+            if (options->max_instructions > 0 && options->max_cycles > 0) {
+                fprintf(out, "    if (instructions >= %lldLL || cycles >= %lldLL) goto stop;\n",
+                        options->max_instructions, options->max_cycles);
+            } else if (options->max_instructions > 0) {
+                fprintf(out, "    if (instructions >= %lldLL) goto stop;\n", options->max_instructions);
+            } else if (options->max_cycles > 0) {
+                fprintf(out, "    if (cycles >= %lldLL) goto stop;\n", options->max_cycles);
+            }
+            fprintf(out, "    instructions += %d;", block->instructions);
+            if (block->cycles) {
+                fprintf(out, " cycles += %d;", block->cycles);
+            }
+            if (block->memory_ops) {
+                fprintf(out, " memory_ops += %d;", block->memory_ops);
+            }
+            fputc('\n', out);
+        }
+        char text[64];
+        format_instruction(program[i], text, sizeof(text));
+        fprintf(out, "    ");
+        emit_instruction(out, program[i], end, has_loads);
+        fprintf(out, "  // %d: %s\n", i, text);
+    }
+    fprintf(out, "    goto halt;\n");
+    if (budget) {
+        fprintf(out, "stop:\n    budget_exhausted = 1;\n");
+    }
+    fprintf(out, "halt:\n");
+    fprintf(out, "    stats->executed_instructions = instructions;\n    stats->clock_cycles = cycles;\n"
+                 "    stats->local_memory_hits = hits;\n    stats->memory_instructions = memory_ops;\n"
+                 "    stats->budget_exhausted = %s;\n", budget ? "budget_exhausted" : "0");
+    if (memory_ops > 0) {
+        fprintf(out, "#undef ACCESS\n#undef HIT\n");
+    }
+    fprintf(out, "}\n\nint main(void) {\n");
+    if (ctx->cache_model_enabled) {
+        const CacheConfig* config = &options->cache;
+        fprintf(out, "    CacheConfig config = {%uu, %uu, %uu, (CachePolicy)%d};\n", config->size,
+                config->line_size, config->associativity, (int)config->policy);
+        fprintf(out, "    if (cache_model_init(&cache, &config) != 0) {\n        return 1;\n    }\n");
+    }
+    fprintf(out, "    ProgramStats stats;\n    run_program(&stats);\n");
+    fprintf(out, "    printf(\"Total number of executed instructions: %%lld\\n\", stats.executed_instructions);\n");
+    fprintf(out, "    printf(\"Total number of clock cycles: %%lld\\n\", stats.clock_cycles);\n");
+    fprintf(out, "    printf(\"Number of hits to local memory: %%lld\\n\", stats.local_memory_hits);\n");
+    fprintf(out, "    printf(\"Total number of executed LD/ST instructions: %%lld\\n\", stats.memory_instructions);\n");
+    fprintf(out, "    if (stats.budget_exhausted) {\n"
+                 "        fprintf(stderr, \"Warning: run budget reached, stopped before the program halted\\n\");\n"
+                 "    }\n    return 0;\n}\n");
+    free(labeled);
+    int ok = !ferror(out);
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "Error: Could not write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// text or a pre-assembled binary, told apart by the magic bytes
+static int iss_load_text(IssContext* ctx, SourceText* text) {
+    iss_unload(ctx);
+    iss_reset(ctx);
+    
+    if (is_binary_program(text)) {
+        if (iss_load_binary(ctx, text) != 0 || iss_prepare(ctx) != 0) {
+            iss_unload(ctx);
+            return -1;
+        }
+        return 0;
+    }
+    ctx->plain_instructions = get_instructions_from_text(text, &ctx->instruction_count, &ctx->first_line_number);
+    if (!ctx->plain_instructions || iss_prepare(ctx) != 0) {
+        iss_unload(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+int iss_load_stream(IssContext* ctx, FILE* file) {
+    SourceText text;
+    if (source_read_stream(&text, file) != 0) {
+        return -1;
+    }
+    int result = iss_load_text(ctx, &text);
+    source_close(&text);
+    return result;
+}
+
+int iss_load_memory(IssContext* ctx, const char* data, size_t size) {
+    SourceText text = {data, size, NULL, 0};
+    // a loaded .issbin stays referenced by the context, so it gets a copy
+    if (is_binary_program(&text)) {
+        text.buffer = malloc(size);
+        if (!text.buffer) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return -1;
+        }
+        memcpy(text.buffer, data, size);
+        text.data = text.buffer;
+    }
+    int result = iss_load_text(ctx, &text);
+    source_close(&text);
+    return result;
+}
+
+int iss_load_copy(IssContext* ctx, const IssContext* source) {
+    iss_unload(ctx);
+    iss_reset(ctx);
+    
+    size_t records = (size_t)(source->instruction_count + source->first_line_number);
+    ctx->plain_instructions = malloc((records + 1) * sizeof(Instruction));
+    if (!ctx->plain_instructions) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return -1;
+    }
+    memcpy(ctx->plain_instructions, source->plain_instructions, records * sizeof(Instruction));
+    ctx->instruction_count = source->instruction_count;
+    ctx->first_line_number = source->first_line_number;
+    if (iss_prepare(ctx) != 0) {
+        iss_unload(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+int iss_load_file(IssContext* ctx, const char* filename) {
+    SourceText text;
+    if (source_open(&text, filename) != 0) {
+        return -1;
+    }
+    int result = iss_load_text(ctx, &text);
+    source_close(&text);
+    return result;
+}
+
+void iss_reset(IssContext* ctx) {
+    memset(&ctx->cpu, 0, sizeof(ctx->cpu));
+    memset(&ctx->memory, 0, sizeof(ctx->memory));
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->fusion_saved_dispatches = 0;
+    ctx->resume_pc = ctx->first_line_number;
+    if (ctx->cache_model_enabled) {
+        cache_model_reset(&ctx->cache_model);
+    }
+}
+
+void iss_set_budget(IssContext* ctx, long long max_instructions, long long max_cycles, int stop_pc) {
+#ifdef JIT_BACKEND
+    if (max_instructions != ctx->options.max_instructions || max_cycles != ctx->options.max_cycles) {
+        jit_free(ctx);
+    }
+#endif
+    ctx->options.max_instructions = max_instructions;
+    ctx->options.max_cycles = max_cycles;
+    ctx->options.stop_pc = stop_pc;
+}
+
+int iss_trace_open(IssContext* ctx, const char* filename) {
+    if (!ctx->instructions) {
+        fprintf(stderr, "Error: load a program before opening a trace\n");
+        return -1;
+    }
+    if (iss_trace_close(ctx) != 0) {
+        return -1;
+    }
+    ctx->trace = trace_writer_open(filename, ctx->instruction_count + ctx->first_line_number);
+    return ctx->trace ? 0 : -1;
+}
+
+int iss_trace_close(IssContext* ctx) {
+    int result = trace_writer_close(ctx->trace);
+    ctx->trace = NULL;
+    return result;
+}
+
+int iss_replay_trace(IssContext* ctx, const char* filename) {
+    TraceReader reader;
+    if (trace_reader_open(&reader, filename) != 0) {
+        return -1;
+    }
+    int runs = 0;
+    int result = 0;
+    while (result == 0 && !trace_reader_at_end(&reader)) {
+        IssStats stats = {0};
+        const TraceBlock* block;
+        while ((result = trace_reader_next_block(&reader, &block, &stats.budget_exhausted)) > 0) {
+            stats.executed_instructions += block->length;
+            stats.clock_cycles += block->cycles;
+            stats.memory_instructions += block->memory_ops;
+            for (uint32_t m = 0; m < block->memory_ops && result > 0; m++) {
+                uint8_t addr;
+                if (trace_reader_next_access(&reader, &addr) != 0) {
+                    result = -1;
+                } else if (is_local_memory_hit(ctx, addr)) {
+                    stats.local_memory_hits++;
+                    stats.clock_cycles += ctx->options.hit_cycles;
+                } else {
+                    stats.clock_cycles += ctx->options.miss_cycles;
+                }
+            }
+            if (result < 0) {
+                break;
+            }
+        }
+        if (result == 0) {
+            ctx->stats = stats;
+            runs++;
+        }
+    }
+    trace_reader_close(&reader);
+    if (result != 0 || runs == 0) {
+        fprintf(stderr, "Error: trace %s is truncated or corrupt\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Checkpoints (.issckpt): everything a stopped run needs to continue in one
+// host-native record, tied to its program by a checksum of the decoded
+// records, with the cache model state appended when the model is on
+#define CHECKPOINT_MAGIC "ISSCKPT\0"
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;          // BINARY_BYTE_ORDER as the writer stored it
+    uint64_t program_checksum;    // binary_checksum() of the decoded records
+    int32_t instruction_count;
+    int32_t first_line_number;
+    // the counters only add up under the same latencies and memory model
+    int32_t hit_cycles;
+    int32_t miss_cycles;
+    int32_t cache_model;
+    CacheConfig cache;            // zero without the cache model
+    int32_t resume_pc;            // leader to continue at, RUN_HALTED once halted
+    CPU cpu;
+    Memory memory;                // first-touch state included
+    IssStats stats;
+    int64_t fusion_saved_dispatches;
+    uint64_t cache_state_size;    // bytes after the header
+    uint64_t checksum;            // binary_checksum() of the file with this field zero
+} CheckpointHeader;
+
+static uint64_t program_checksum(IssContext* ctx) {
+    if (!ctx->program_checksum) {
+        size_t records = (size_t)(ctx->instruction_count + ctx->first_line_number);
+        ctx->program_checksum = binary_checksum((const uint8_t*)ctx->plain_instructions,
+                                                records * sizeof(Instruction));
+    }
+    return ctx->program_checksum;
+}
+
+int iss_save_checkpoint(IssContext* ctx, const char* filename) {
+    if (!ctx->plain_instructions) {
+        fprintf(stderr, "Error: no program loaded\n");
+        return -1;
+    }
+    if (ctx->resume_pc == RUN_UNRESUMABLE) {
+        fprintf(stderr, "Error: the run stopped in generated code, which keeps no pc to checkpoint\n");
+        return -1;
+    }
+    size_t state_size = ctx->cache_model_enabled ? cache_model_state_size(&ctx->cache_model) : 0;
+    size_t size = sizeof(CheckpointHeader) + state_size;
+    uint8_t* data = malloc(size);
+    char* temporary = malloc(strlen(filename) + 5);
+    if (!data || !temporary) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(data);
+        free(temporary);
+        return -1;
+    }
+    
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.version = CHECKPOINT_VERSION;
+    header.byte_order = BINARY_BYTE_ORDER;
+    header.program_checksum = program_checksum(ctx);
+    header.instruction_count = ctx->instruction_count;
+    header.first_line_number = ctx->first_line_number;
+    header.hit_cycles = ctx->options.hit_cycles;
+    header.miss_cycles = ctx->options.miss_cycles;
+    header.cache_model = ctx->cache_model_enabled;
+    if (ctx->cache_model_enabled) {
+        header.cache = ctx->cache_model.config;
+        cache_model_save_state(&ctx->cache_model, data + sizeof(header));
+    }
+    header.resume_pc = ctx->resume_pc;
+    header.cpu = ctx->cpu;
+    header.memory = ctx->memory;
+    header.stats = ctx->stats;
+    header.fusion_saved_dispatches = ctx->fusion_saved_dispatches;
+    header.cache_state_size = state_size;
+    memcpy(data, &header, sizeof(header));
+    header.checksum = binary_checksum(data, size);
+    memcpy(data, &header, sizeof(header));
+    
+    // written next to the target and renamed over it, so an interrupted
+    // save leaves the previous checkpoint intact
+    sprintf(temporary, "%s.tmp", filename);
+    FILE* file = fopen(temporary, "wb");
+    int ok = file != NULL;
+    if (file) {
+        ok = fwrite(data, 1, size, file) == size;
+        ok = (fclose(file) == 0) && ok;
+    }
+    ok = ok && rename(temporary, filename) == 0;
+    if (!ok) {
+        if (file) {
+            remove(temporary);
+        }
+        fprintf(stderr, "Error: Could not write %s\n", filename);
+    }
+    free(data);
+    free(temporary);
+    return ok ? 0 : -1;
+}
+
+int iss_load_checkpoint(IssContext* ctx, const char* filename) {
+    if (!ctx->plain_instructions) {
+        fprintf(stderr, "Error: load a program before its checkpoint\n");
+        return -1;
+    }
+    SourceText text;
+    if (source_open(&text, filename) != 0) {
+        return -1;
+    }
+    CheckpointHeader header;
+    if (text.size < sizeof(header)) {
+        fprintf(stderr, "Error: %s is not a version %d checkpoint for this host\n", filename, CHECKPOINT_VERSION);
+        source_close(&text);
+        return -1;
+    }
+    memcpy(&header, text.data, sizeof(header));
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0 || header.version != CHECKPOINT_VERSION ||
+        header.byte_order != BINARY_BYTE_ORDER) {
+        fprintf(stderr, "Error: %s is not a version %d checkpoint for this host\n", filename, CHECKPOINT_VERSION);
+        source_close(&text);
+        return -1;
+    }
+    
+    // the checksum covers the file with its own field zero
+    uint8_t* data = malloc(text.size);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        source_close(&text);
+        return -1;
+    }
+    memcpy(data, text.data, text.size);
+    memset(data + offsetof(CheckpointHeader, checksum), 0, sizeof(header.checksum));
+    int intact = header.cache_state_size == text.size - sizeof(header) &&
+                 binary_checksum(data, text.size) == header.checksum;
+    source_close(&text);
+    
+    int end = ctx->instruction_count + ctx->first_line_number;
+    size_t state_size = ctx->cache_model_enabled ? cache_model_state_size(&ctx->cache_model) : 0;
+    int result = -1;
+    if (!intact) {
+        fprintf(stderr, "Error: checkpoint %s is truncated or corrupt\n", filename);
+    } else if (header.instruction_count != ctx->instruction_count ||
+               header.first_line_number != ctx->first_line_number ||
+               header.program_checksum != program_checksum(ctx)) {
+        fprintf(stderr, "Error: checkpoint %s belongs to another program\n", filename);
+    } else if (header.hit_cycles != ctx->options.hit_cycles || header.miss_cycles != ctx->options.miss_cycles ||
+               header.cache_model != ctx->cache_model_enabled || header.cache_state_size != state_size ||
+               (ctx->cache_model_enabled &&
+                memcmp(&header.cache, &ctx->cache_model.config, sizeof(header.cache)) != 0)) {
+        fprintf(stderr, "Error: checkpoint %s was taken with other latencies or another memory model\n", filename);
+    } else if (header.resume_pc != RUN_HALTED &&
+               (header.resume_pc < 0 || header.resume_pc >= end || !is_block_leader(ctx, header.resume_pc))) {
+        fprintf(stderr, "Error: checkpoint %s is truncated or corrupt\n", filename);
+    } else {
+        ctx->cpu = header.cpu;
+        ctx->memory = header.memory;
+        ctx->stats = header.stats;
+        ctx->fusion_saved_dispatches = header.fusion_saved_dispatches;
+        ctx->resume_pc = header.resume_pc;
+        if (ctx->cache_model_enabled) {
+            cache_model_load_state(&ctx->cache_model, data + sizeof(header));
+        }
+#ifdef ISS_PROFILE
+        // the profile covers what runs from here
+        memset(ctx->profile, 0, ((size_t)end + 1) * sizeof(ProfileCounter));
+#endif
+        result = 0;
+    }
+    free(data);
+    return result;
+}
+
+void iss_get_stats(const IssContext* ctx, IssStats* stats) {
+    *stats = ctx->stats;
+}
+
+void iss_print_cache_stats(const IssContext* ctx, FILE* out) {
+    if (ctx->cache_model_enabled) {
+        cache_model_print_stats(&ctx->cache_model, out);
+    }
+}
+
+#ifdef ISS_PROFILE
+typedef struct {
+    int pc;
+    long long executions;
+    long long cycles;
+    long long hits;
+    long long misses;
+} ProfileRow;
+
+// a block or a loop, records first..last
+typedef struct {
+    int first;
+    int last;
+    long long runs;     // block entries, or executions of the loop's back edge
+    long long cycles;
+} ProfileRange;
+
+// most cycles first, then most executions (INVALID records cost none),
+// ties in program order
+static int profile_row_compare(const void* a, const void* b) {
+    const ProfileRow* x = a;
+    const ProfileRow* y = b;
+    if (x->cycles != y->cycles) {
+        return x->cycles < y->cycles ? 1 : -1;
+    }
+    if (x->executions != y->executions) {
+        return x->executions < y->executions ? 1 : -1;
+    }
+    return (x->pc > y->pc) - (x->pc < y->pc);
+}
+
+static int profile_range_compare(const void* a, const void* b) {
+    const ProfileRange* x = a;
+    const ProfileRange* y = b;
+    if (x->cycles != y->cycles) {
+        return x->cycles < y->cycles ? 1 : -1;
+    }
+    return (x->first > y->first) - (x->first < y->first);
+}
+
+static double profile_share(long long cycles, long long total) {
+    return total > 0 ? 100.0 * (double)cycles / (double)total : 0.0;
+}
+
+void iss_print_profile(const IssContext* ctx, FILE* out, int top) {
+    int end = ctx->instruction_count + ctx->first_line_number;
+    ProfileRow* rows = malloc(((size_t)end + 1) * sizeof(ProfileRow));
+    ProfileRange* blocks = malloc(((size_t)end + 1) * sizeof(ProfileRange));
+    ProfileRange* loops = malloc(((size_t)end + 1) * sizeof(ProfileRange));
+    if (!rows || !blocks || !loops) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free(rows);
+        free(blocks);
+        free(loops);
+        return;
+    }
+    
+    // expand block entries into per-record counts, in program order so the
+    // block and loop sums below can index rows by pc
+    int block_count = 0;
+    long long total_cycles = 0;
+    long long executions = 0;
+    ProfileRange* block = NULL;
+    for (int pc = 0; pc < end; pc++) {
+        if (is_block_leader(ctx, pc)) {
+            executions = ctx->profile[pc].block_runs;
+            if (executions > 0) {
+                blocks[block_count] = (ProfileRange){pc, ctx->blocks[pc].end - 1, executions, 0};
+                block = &blocks[block_count++];
+            } else {
+                block = NULL;
+            }
+        }
+        Instruction inst = ctx->plain_instructions[pc];
+        ProfileRow* row = &rows[pc];
+        row->pc = pc;
+        row->executions = executions;
+        row->misses = 0;
+        row->hits = 0;
+        row->cycles = (inst.type != INVALID) ? executions : 0;
+        if (inst.type == LD_REG_REG || inst.type == LD_REV_REG_REG || inst.type == ST_REG_REG) {
+            row->misses = ctx->profile[pc].misses;
+            row->hits = executions - row->misses;
+            row->cycles += row->hits * ctx->options.hit_cycles + row->misses * ctx->options.miss_cycles;
+        }
+        if (block) {
+            block->cycles += row->cycles;
+        }
+        total_cycles += row->cycles;
+    }
+    
+    // a loop is every backward JE/JMP that ran, cycles are inclusive of
+    // any loop nested in it
+    int loop_count = 0;
+    for (int pc = 0; pc < end; pc++) {
+        Instruction inst = ctx->plain_instructions[pc];
+        if ((inst.type == JE_ADDR || inst.type == JMP_ADDR) && inst.arg1 >= 0 && inst.arg1 <= pc &&
+            rows[pc].executions > 0) {
+            ProfileRange* loop = &loops[loop_count++];
+            *loop = (ProfileRange){inst.arg1, pc, rows[pc].executions, 0};
+            for (int p = inst.arg1; p <= pc; p++) {
+                loop->cycles += rows[p].cycles;
+            }
+        }
+    }
+    
+    qsort(rows, (size_t)end, sizeof(ProfileRow), profile_row_compare);
+    qsort(blocks, (size_t)block_count, sizeof(ProfileRange), profile_range_compare);
+    qsort(loops, (size_t)loop_count, sizeof(ProfileRange), profile_range_compare);
+    
+    fprintf(out, "Profile: %lld clock cycles\n", total_cycles);
+    fprintf(out, "%8s %14s %14s %7s %12s %12s  %s\n", "line", "executions", "cycles", "share", "hits", "misses",
+            "instruction");
+    for (int r = 0; r < end && (top == 0 || r < top) && rows[r].executions > 0; r++) {
+        char text[64];
+        format_instruction(ctx->plain_instructions[rows[r].pc], text, sizeof(text));
+        fprintf(out, "%8d %14lld %14lld %6.2f%% %12lld %12lld  %s\n", rows[r].pc, rows[r].executions,
+                rows[r].cycles, profile_share(rows[r].cycles, total_cycles), rows[r].hits, rows[r].misses, text);
+    }
+    fprintf(out, "Basic blocks: %d executed\n", block_count);
+    fprintf(out, "%8s %8s %14s %14s %7s\n", "first", "last", "entries", "cycles", "share");
+    for (int b = 0; b < block_count && (top == 0 || b < top); b++) {
+        fprintf(out, "%8d %8d %14lld %14lld %6.2f%%\n", blocks[b].first, blocks[b].last, blocks[b].runs,
+                blocks[b].cycles, profile_share(blocks[b].cycles, total_cycles));
+    }
+    fprintf(out, "Loops: %d backward branches executed\n", loop_count);
+    fprintf(out, "%8s %8s %14s %14s %7s\n", "head", "branch", "branch runs", "cycles", "share");
+    for (int l = 0; l < loop_count && (top == 0 || l < top); l++) {
+        fprintf(out, "%8d %8d %14lld %14lld %6.2f%%\n", loops[l].first, loops[l].last, loops[l].runs,
+                loops[l].cycles, profile_share(loops[l].cycles, total_cycles));
+    }
+    
+    free(rows);
+    free(blocks);
+    free(loops);
+}
+#endif
@@ -0,0 +1,162 @@
+#ifndef ISS_H
+#define ISS_H
+
+#include <stdio.h>
+
+#include "cache.h"
+
+// libiss: the simulator core behind an explicit context. Every piece of
+// machine and program state lives in the IssContext, so one process can
+// load and run any number of programs, and independent contexts can run on
+// different threads. A context is not safe to share between threads.
+//
+//   IssOptions options;
+//   iss_options_default(&options);
+//   IssContext* ctx = iss_create(&options);
+//   iss_load_file(ctx, "sample.assembly");
+//   iss_run(ctx);
+//   iss_get_stats(ctx, &stats);
+//   iss_reset(ctx);   // fresh machine, same program, ready to run again
+//   iss_destroy(ctx);
+
+typedef struct IssContext IssContext;
+
+// default extra cycles of an LD/ST that hits or misses local memory, on
+// top of the one cycle every instruction takes
+#define CACHE_HIT_CYCLES 2
+#define CACHE_MISS_CYCLES 50
+
+typedef struct {
+    int cache_model;    // use the set-associative model in cache instead of first-touch
+    CacheConfig cache;
+    int hit_cycles;     // LD/ST latencies, CACHE_HIT_CYCLES and CACHE_MISS_CYCLES by default
+    int miss_cycles;
+    int fusion;         // superinstruction fusion in the interpreters
+    int fast_forward;   // counted-loop fast-forward in the interpreters
+    int jit;            // translate at load, JIT_BACKEND builds only
+    // run budget, 0 = unlimited. Checked once per basic block: the run stops
+    // at the first block entry where a counter has reached its limit
+    long long max_instructions;
+    long long max_cycles;
+    // stop at the next entry of the basic block starting at this line, -1
+    // never (default). The block the run starts or resumes at only counts
+    // once control comes back to it. iss_run and iss_resume only
+    int stop_pc;
+} IssOptions;
+
+// counters of the last iss_run, a resumed run's cover all of it
+typedef struct {
+    long long executed_instructions;
+    long long clock_cycles;
+    long long local_memory_hits;
+    long long memory_instructions;  // executed LD/ST
+    int budget_exhausted;           // stopped by the budget before the program halted
+    int stopped_at_pc;              // stopped at stop_pc before the program halted
+} IssStats;
+
+// fill in the defaults (first-touch memory, default latencies, fusion and
+// fast-forward on, no budget, no stop line)
+void iss_options_default(IssOptions* options);
+
+// returns NULL on failure (message on stderr)
+IssContext* iss_create(const IssOptions* options);
+void iss_destroy(IssContext* ctx);
+
+// load a program, replacing any previous one, and reset the machine. The
+// text may also be a pre-assembled .issbin (see iss_save_binary)
+// returns 0 on success, -1 on failure (message on stderr)
+int iss_load_file(IssContext* ctx, const char* filename);
+int iss_load_stream(IssContext* ctx, FILE* file);
+// program text (or .issbin image) already in memory, the context keeps no
+// reference to it
+int iss_load_memory(IssContext* ctx, const char* data, size_t size);
+// load the program already decoded in source without parsing it again,
+// everything else is derived for this context's own options
+int iss_load_copy(IssContext* ctx, const IssContext* source);
+
+// write the loaded program as a pre-assembled .issbin: decoded records and
+// basic-block table behind a versioned, checksummed header. Loading one is
+// a mapping plus a checksum pass, with no parsing or block analysis.
+// returns 0 on success, -1 on failure (message on stderr)
+int iss_save_binary(const IssContext* ctx, const char* filename);
+
+// translate the loaded program to a standalone C file for ahead-of-time
+// compilation: one labelled goto target per branch target, block counters
+// added on entry, and LD/ST inlined against first-touch memory or, with the
+// cache model on, cache.h (link cache.c). Latencies and the run budget are
+// compiled in. Its output matches `myISS <assembly_file>` with the same options.
+// returns 0 on success, -1 on failure (message on stderr)
+int iss_emit_c(const IssContext* ctx, const char* filename);
+
+// run the loaded program from its first line. Registers start at zero,
+// memory and cache residency carry over from earlier runs until iss_reset
+void iss_run(IssContext* ctx);
+
+// clear registers, flags, memory, cache state and counters, keep the program
+void iss_reset(IssContext* ctx);
+
+// continue a run that stopped on its budget or stop line from the block it
+// stopped at, with its registers and counters, so the stats then cover the
+// whole run. Starts the program after a load or iss_reset, does nothing once
+// it halted. Always interprets: runs of the JIT keep no pc to resume from,
+// and a traced run is not resumed.
+// returns 0 on success, -1 if the run cannot be resumed (message on stderr)
+int iss_resume(IssContext* ctx);
+
+// change the budget and stop line (see IssOptions) of the following runs.
+// JIT builds drop the generated code, which has the old budget built in,
+// and interpret from then on
+void iss_set_budget(IssContext* ctx, long long max_instructions, long long max_cycles, int stop_pc);
+
+// Checkpoints: save the machine state of a stopped run (registers, flag,
+// resume pc, memory, first-touch or cache model state and counters) to a
+// small versioned, checksummed file, and restore it into a context with the
+// same program, latencies and memory model, ready for iss_resume. Host-native
+// like .issbin. Saving writes a few hundred bytes plus the cache model
+// state, and replaces the file atomically, so it can be taken periodically.
+// returns 0 on success, -1 on failure (message on stderr)
+int iss_save_checkpoint(IssContext* ctx, const char* filename);
+int iss_load_checkpoint(IssContext* ctx, const char* filename);
+
+// SIMD lanes: run the loaded program once per initial state, up to
+// ISS_MAX_LANES states at a time in lockstep, and fill in stats[k] for
+// state k. Every lane starts from its own registers and memory with a cold
+// cache, like a fresh context; the context's own machine state is untouched.
+// returns 0 on success, -1 if the program uses registers the lanes lack
+#define ISS_MAX_LANES 32
+
+typedef struct {
+    int8_t registers[6];    // R1-R6
+    uint8_t memory[256];
+} IssLaneState;
+
+int iss_run_lanes(IssContext* ctx, const IssLaneState* initial, int count, IssStats* stats);
+
+// Execution traces: record the block stream and every LD/ST address of the
+// following runs to a compact binary file (format in trace.h), written by a
+// background thread. Tracing runs the interpreter without fast-forward, the
+// JIT is bypassed. A trace covers the program loaded when it was opened,
+// loading another program or destroying the context closes it.
+// returns 0 on success, -1 on failure (message on stderr)
+int iss_trace_open(IssContext* ctx, const char* filename);
+// flush and close the trace, -1 if it could not be written completely
+int iss_trace_close(IssContext* ctx);
+
+// cost a recorded trace again under this context's latencies and memory
+// model, without its program. Runs in the trace replay like iss_run calls,
+// residency carries over until iss_reset and the stats are the last run's.
+// returns 0 on success, -1 on failure (message on stderr)
+int iss_replay_trace(IssContext* ctx, const char* filename);
+
+void iss_get_stats(const IssContext* ctx, IssStats* stats);
+void iss_print_cache_stats(const IssContext* ctx, FILE* out);
+void iss_print_fusion_stats(const IssContext* ctx, FILE* out);
+
+#ifdef ISS_PROFILE
+// per-PC profile of the last iss_run (ISS_PROFILE builds, switch engine
+// only): the hottest records by cycles with their line numbers, then the
+// hottest basic blocks and loops. top limits each list, 0 prints everything
+void iss_print_profile(const IssContext* ctx, FILE* out, int top);
+#endif
+
+#endif
@@ -2,26 +2,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include "cache.h"
+#include "source.h"
 
-#define MAX_LINE_LENGTH 256
-#define MAX_MEMORY_ADDRESSES 10000
 #define CACHE_HIT_CYCLES 2
 #define CACHE_MISS_CYCLES 50 // miss penalty
 #define LOCAL_MEMORY_SIZE 256 // 256-byte local memory
 
 // global structs
 typedef struct {
-    uint32_t total_instructions;
-    uint32_t total_cycles;
-    uint32_t memory_hits;
-    uint32_t ld_st_instructions;
+    uint64_t total_instructions;
+    uint64_t total_cycles;
+    uint64_t memory_hits;
+    uint64_t ld_st_instructions;
 } SimulatorStats;
 
-// optimized with validity tracking
+// residency bitmap, one bit per byte of local memory
+// addresses are wrapped to 8 bits, so 256 bits cover every possible address
 typedef struct {
-    uint32_t addresses[MAX_MEMORY_ADDRESSES];
-    uint8_t valid[MAX_MEMORY_ADDRESSES];  // track which slots are valid
-    int count;
+    uint64_t resident[LOCAL_MEMORY_SIZE / 64];
 } Cache;
 
 // cpu simulation
@@ -31,51 +33,196 @@ typedef struct {
     uint8_t zero_flag; // for cmp instruction
 } CPU;
 
+// pre-decoded opcodes, one per source line
+typedef enum {
+    OP_NOP = 0,   // unrecognised or malformed line, still costs one cycle
+    OP_MOV_IMM,
+    OP_MOV_REG,
+    OP_ADD_IMM,
+    OP_ADD_REG,
+    OP_CMP,
+    OP_JE,
+    OP_JMP,
+    OP_LD_REG,    // ld rd, [rs]
+    OP_LD_IMM,    // ld rd, [imm]
+    OP_ST_REG,    // st [rs], r
+    OP_ST_IMM,    // st [imm], r
+    OP_LDST_NOP   // malformed LD/ST, counted but no memory access
+} Opcode;
+
+// compact decoded record, 8 bytes per line
+typedef struct {
+    uint8_t op;
+    uint8_t rd;     // destination / first register
+    uint8_t rs;     // source / address register
+    int8_t imm;     // immediate value or low byte of an immediate address
+    int32_t target; // resolved instruction index for JE/JMP
+} DecodedInstruction;
+
+// most a run_block from this record can cost: the instructions up to the
+// next JMP or the end and their cycles with every LD/ST missing
+typedef struct {
+    uint64_t cycles;
+    uint32_t instructions;
+} RunBound;
+
 // global variables
 SimulatorStats stats = {0, 0, 0, 0};
 Cache cache = {0};
+CacheModel cache_model;          // optional set-associative model
+int cache_model_enabled = 0;     // replaces the residency bitmap when set
 CPU cpu = {0};
 
-// global arrays for line number mapping
-char global_lines[1000][MAX_LINE_LENGTH];
-int global_line_numbers[1000];
+// decoded program and line numbers, one arena sized from the file's line count
+void* program_arena = NULL;
+RunBound* global_run_bounds = NULL;
+DecodedInstruction* global_program = NULL;
+int* global_line_numbers = NULL;
+int* global_target_lines = NULL;   // JE/JMP line numbers until resolved
 int global_line_count = 0;
 
-// find instruction index from line number
-int find_instruction_index(int target_line) {
-    if (global_line_count > 0 && global_line_numbers[0] > 0) {
-        // has explicit line numbers
-        for (int i = 0; i < global_line_count; i++) {
-            if (global_line_numbers[i] == target_line) {
-                return i;
-            }
+// run budget, 0 = unlimited. Checked after each taken branch, so once per
+// basic block, and per instruction only for the last block that would cross
+// it, so a run stops exactly at the limit. The instruction cap keeps the
+// shipped programs that never halt finite
+#define DEFAULT_MAX_INSTRUCTIONS 100000
+uint64_t max_instructions = DEFAULT_MAX_INSTRUCTIONS;
+uint64_t max_cycles = 0;
+int budget_exhausted = 0;        // the last run stopped at the budget
+int never_halts = 0;             // the last run repeated a state with no budget set
+
+// jump-target index, line number -> instruction index, built once at load
+// dense table over [min, max] when numbering is compact, hash table otherwise
+typedef struct {
+    int* slots;        // dense: index per line number, hash: instruction index
+    int* keys;         // hash only: line number stored in each slot
+    int min_line;
+    int max_line;
+    uint32_t mask;     // hash only: table size - 1
+    int shift;         // hash only: 32 - log2(table size)
+    int dense;
+} LineIndex;
+
+LineIndex line_index = {NULL, NULL, 0, 0, 0, 0, 0};
+
+// multiplicative hash, the top bits of the product: the low bits only depend
+// on the low bits of the line, so numbering in steps of 65536 would collide
+uint32_t hash_line_number(int line) {
+    return ((uint32_t)line * 2654435761u) >> line_index.shift;
+}
+
+// build the jump-target index, the first line with a given number wins
+void build_line_index() {
+    free(line_index.slots);
+    free(line_index.keys);
+    line_index.slots = NULL;
+    line_index.keys = NULL;
+    line_index.min_line = 0;
+    line_index.max_line = -1;
+    
+    if (global_line_count == 0) {
+        line_index.dense = 1;
+        return;
+    }
+    
+    int min_line = global_line_numbers[0];
+    int max_line = global_line_numbers[0];
+    for (int i = 1; i < global_line_count; i++) {
+        if (global_line_numbers[i] < min_line) min_line = global_line_numbers[i];
+        if (global_line_numbers[i] > max_line) max_line = global_line_numbers[i];
+    }
+    line_index.min_line = min_line;
+    line_index.max_line = max_line;
+    
+    // dense when the range wastes at most ~4 slots per instruction
+    int64_t range = (int64_t)max_line - min_line + 1;
+    line_index.dense = (range <= 4 * (int64_t)global_line_count + 64);
+    
+    if (line_index.dense) {
+        line_index.slots = malloc((size_t)range * sizeof(int));
+        if (!line_index.slots) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
         }
-        return -1; // line not found
-    } else {
-        // no explicit line numbers
-        if (target_line >= 1 && target_line <= global_line_count) {
-            return target_line - 1; // convert to 0-based index
+        for (int64_t i = 0; i < range; i++) {
+            line_index.slots[i] = -1;
+        }
+        for (int i = global_line_count - 1; i >= 0; i--) {
+            line_index.slots[global_line_numbers[i] - min_line] = i;
+        }
+        return;
+    }
+    
+    // sparse numbering: open addressing with linear probing, load factor <= 0.5
+    uint32_t size = 16;
+    int shift = 28;
+    while (size < 2 * (uint32_t)global_line_count) {
+        size <<= 1;
+        shift--;
+    }
+    line_index.mask = size - 1;
+    line_index.shift = shift;
+    line_index.slots = malloc(size * sizeof(int));
+    line_index.keys = malloc(size * sizeof(int));
+    if (!line_index.slots || !line_index.keys) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        line_index.slots[i] = -1;
+    }
+    for (int i = 0; i < global_line_count; i++) {
+        uint32_t h = hash_line_number(global_line_numbers[i]);
+        while (line_index.slots[h] >= 0 && line_index.keys[h] != global_line_numbers[i]) {
+            h = (h + 1) & line_index.mask;
+        }
+        if (line_index.slots[h] < 0) {
+            line_index.slots[h] = i;
+            line_index.keys[h] = global_line_numbers[i];
         }
-        return -1; // invalid index
     }
 }
 
-// optimized cache hit check, exits early to skip the rest of the loop
-int is_cache_hit(uint32_t address) {
-    for (int i = 0; i < cache.count; i++) {
-        if (cache.valid[i] && cache.addresses[i] == address) {
-            return 1;
+// find instruction index from line number in O(1), -1 if no such line
+int find_instruction_index(int target_line) {
+    if (target_line < line_index.min_line || target_line > line_index.max_line) {
+        return -1; // line not found
+    }
+    if (line_index.dense) {
+        return line_index.slots[target_line - line_index.min_line];
+    }
+    uint32_t h = hash_line_number(target_line);
+    while (line_index.slots[h] >= 0) {
+        if (line_index.keys[h] == target_line) {
+            return line_index.slots[h];
         }
+        h = (h + 1) & line_index.mask;
     }
-    return 0;
+    return -1; // line not found
+}
+
+// constant-time cache hit check, one bit test
+int is_cache_hit(uint8_t address) {
+    return (int)((cache.resident[address >> 6] >> (address & 63)) & 1);
+}
+
+// mark an address resident
+void add_to_cache(uint8_t address) {
+    cache.resident[address >> 6] |= (uint64_t)1 << (address & 63);
 }
 
-// optimized cache add
-void add_to_cache(uint32_t address) {
-    if (cache.count < MAX_MEMORY_ADDRESSES) {
-        cache.addresses[cache.count] = address;
-        cache.valid[cache.count] = 1;
-        cache.count++;
+// forget every resident address, clears 32 bytes
+void reset_cache() {
+    memset(cache.resident, 0, sizeof(cache.resident));
+}
+
+// reset cpu, stats and cache so another program can run in the same process
+void reset_simulator() {
+    memset(&cpu, 0, sizeof(cpu));
+    memset(&stats, 0, sizeof(stats));
+    reset_cache();
+    if (cache_model_enabled) {
+        cache_model_reset(&cache_model);
     }
 }
 
@@ -85,6 +232,14 @@ uint32_t simulate_memory_access(uint32_t address) {
     // wrap around
     uint8_t wrapped_address = (uint8_t)address;
     
+    if (cache_model_enabled) {
+        if (cache_model_access(&cache_model, wrapped_address)) {
+            stats.memory_hits++;
+            return CACHE_HIT_CYCLES;
+        }
+        return CACHE_MISS_CYCLES;
+    }
+    
     if (is_cache_hit(wrapped_address)) {
         stats.memory_hits++;
         return CACHE_HIT_CYCLES;
@@ -136,9 +291,9 @@ uint32_t fast_parse_int(const char* str, int len) {
 }
 
 // parse register number from string like "R1"
-int parse_register(const char* str) {
-    if (str[0] == 'R') {
-        int reg_num = atoi(str + 1);
+int parse_register(const char* str, const char* end) {
+    if (str < end && str[0] == 'R') {
+        int reg_num = span_atoi(str + 1, end);
         // accept R1-R6
         if (reg_num >= 1 && reg_num <= 6) {
             return reg_num;
@@ -147,241 +302,166 @@ int parse_register(const char* str) {
     return -1;
 }
 
+// skip spaces inside an operand list
+const char* skip_spaces(const char* ptr, const char* end) {
+    while (ptr < end && *ptr == ' ') {
+        ptr++;
+    }
+    return ptr;
+}
+
 // skip whitespace and line numbers, return pointer to instruction
-char* skip_line_prefix(char* line) {
-    char* ptr = line;
+const char* skip_line_prefix(const char* line, const char* end) {
+    const char* ptr = line;
     
     // skip leading whitespace
-    while (*ptr == ' ' || *ptr == '\t') {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
         ptr++;
     }
     
     // skip line numbers (digits at start)
-    while (*ptr >= '0' && *ptr <= '9') {
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') {
         ptr++;
     }
     
     // skip whitespace after line number
-    while (*ptr == ' ' || *ptr == '\t') {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
         ptr++;
     }
     
     return ptr;
 }
 
-// optimized instruction execution
-void execute_instruction(char* line) {
-    uint32_t cycles = 1;
-    stats.total_instructions++;
+// decode one source line [line, end) into a compact record, done once at
+// load time straight from the mapped file
+// mirrors the original text interpreter exactly, malformed operands become
+// OP_NOP (or OP_LDST_NOP for LD/ST, which still count as memory instructions)
+DecodedInstruction decode_instruction(const char* line, const char* end, int* target_line) {
+    DecodedInstruction inst = {OP_NOP, 0, 0, 0, -1};
+    *target_line = 0;
     
     // skip line prefix (line numbers, whitespace)
-    char* instruction = skip_line_prefix(line);
+    const char* instruction = skip_line_prefix(line, end);
     
     // parse instruction type
-    if (strncmp(instruction, "MOV", 3) == 0) {
-        // mov r1, 5 or mov r1, r2
-        char* comma = strchr(instruction, ',');
+    if (span_starts_with(instruction, end, "MOV") || span_starts_with(instruction, end, "ADD")) {
+        // mov/add r1, 5 or mov/add r1, r2
+        int is_mov = (instruction[0] == 'M');
+        const char* comma = span_find(instruction, end, ',');
         if (comma) {
-            char* reg_str = instruction + 3;
-            while (*reg_str == ' ') reg_str++;
-            
-            char* value_str = comma + 1;
-            while (*value_str == ' ') value_str++;
+            const char* reg_str = skip_spaces(instruction + 3, end);
+            const char* value_str = skip_spaces(comma + 1, end);
             
-            int reg = parse_register(reg_str);
+            int reg = parse_register(reg_str, end);
             if (reg >= 1 && reg <= 6) {
-                if (value_str[0] == 'R') {
-                    // mov r1, r2
-                    int src_reg = parse_register(value_str);
+                if (value_str < end && value_str[0] == 'R') {
+                    int src_reg = parse_register(value_str, end);
                     if (src_reg >= 1 && src_reg <= 6) {
-                        cpu.registers[reg] = cpu.registers[src_reg];
+                        inst.op = is_mov ? OP_MOV_REG : OP_ADD_REG;
+                        inst.rd = (uint8_t)reg;
+                        inst.rs = (uint8_t)src_reg;
                     }
                 } else {
-                    // mov r1, 5
                     // validate 8-bit range [-128, 127]
-                    int value = atoi(value_str);
-                    if (value < -128) value = -128;
-                    if (value > 127) value = 127;
-                    cpu.registers[reg] = (int8_t)value;
-                }
-            }
-        }
-    }
-    else if (strncmp(instruction, "ADD", 3) == 0) {
-        // add r1, 5 or add r1, r2
-        char* comma = strchr(instruction, ',');
-        if (comma) {
-            char* reg_str = instruction + 3;
-            while (*reg_str == ' ') reg_str++;
-            
-            char* value_str = comma + 1;
-            while (*value_str == ' ') value_str++;
-            
-            int reg = parse_register(reg_str);
-            if (reg >= 1 && reg <= 6) {
-                if (value_str[0] == 'R') {
-                    // add r1, r2
-                    int src_reg = parse_register(value_str);
-                    if (src_reg >= 1 && src_reg <= 6) {
-                        cpu.registers[reg] += cpu.registers[src_reg];
-                    }
-                } else {
-                    // add r1, 5
-                    int value = atoi(value_str);
+                    int value = span_atoi(value_str, end);
                     if (value < -128) value = -128;
                     if (value > 127) value = 127;
-                    cpu.registers[reg] += (int8_t)value;
+                    inst.op = is_mov ? OP_MOV_IMM : OP_ADD_IMM;
+                    inst.rd = (uint8_t)reg;
+                    inst.imm = (int8_t)value;
                 }
             }
         }
     }
-    else if (strncmp(instruction, "CMP", 3) == 0) {
+    else if (span_starts_with(instruction, end, "CMP")) {
         // cmp r1, r2
-        char* comma = strchr(instruction, ',');
+        const char* comma = span_find(instruction, end, ',');
         if (comma) {
-            char* reg1_str = instruction + 3;
-            while (*reg1_str == ' ') reg1_str++;
-            
-            char* reg2_str = comma + 1;
-            while (*reg2_str == ' ') reg2_str++;
+            const char* reg1_str = skip_spaces(instruction + 3, end);
+            const char* reg2_str = skip_spaces(comma + 1, end);
             
-            int reg1 = parse_register(reg1_str);
-            int reg2 = parse_register(reg2_str);
+            int reg1 = parse_register(reg1_str, end);
+            int reg2 = parse_register(reg2_str, end);
             
             if (reg1 >= 1 && reg1 <= 6 && reg2 >= 1 && reg2 <= 6) {
-                cpu.zero_flag = (cpu.registers[reg1] == cpu.registers[reg2]);
+                inst.op = OP_CMP;
+                inst.rd = (uint8_t)reg1;
+                inst.rs = (uint8_t)reg2;
             }
         }
     }
-    else if (strncmp(instruction, "JE", 2) == 0) {
-        // je 19 (jump if equal)
-        char* target_str = instruction + 2;
-        while (*target_str == ' ') target_str++;
+    else if (span_starts_with(instruction, end, "JE") || span_starts_with(instruction, end, "JMP")) {
+        // je 19 / jmp 13, target resolved once every line is known
+        int is_je = (instruction[1] == 'E');
+        const char* target_str = skip_spaces(instruction + (is_je ? 2 : 3), end);
         
-        if (cpu.zero_flag) {
-            int target_line = atoi(target_str);
-            int target_index = find_instruction_index(target_line);
-            if (target_index >= 0 && target_index < global_line_count) {
-                cpu.pc = target_index;
-                stats.total_cycles += cycles;
-                return; // don't increment pc normally
-            }
-            // invalid jump target, halt!
-            cpu.pc = global_line_count;
-            stats.total_cycles += cycles;
-            return;
-        }
-    }
-    else if (strncmp(instruction, "JMP", 3) == 0) {
-        // jmp 13 (unconditional jump)
-        char* target_str = instruction + 3;
-        while (*target_str == ' ') target_str++;
-        
-        int target_line = atoi(target_str);
-        int target_index = find_instruction_index(target_line);
-        if (target_index >= 0 && target_index < global_line_count) {
-            cpu.pc = target_index;
-            stats.total_cycles += cycles;
-            return; // don't increment pc normally
-        }
-        // invalid jump target! halt!
-        cpu.pc = global_line_count;
-        stats.total_cycles += cycles;
-        return;
+        inst.op = is_je ? OP_JE : OP_JMP;
+        *target_line = span_atoi(target_str, end);
     }
-    else if (strncmp(instruction, "LD", 2) == 0) {
+    else if (span_starts_with(instruction, end, "LD")) {
         // ld r5, [r3] or ld [r3], r5
-        stats.ld_st_instructions++;
+        inst.op = OP_LDST_NOP;
         
-        char* comma = strchr(instruction, ',');
+        const char* comma = span_find(instruction, end, ',');
         if (comma) {
-            char* reg_str = instruction + 2;
-            while (*reg_str == ' ') reg_str++;
+            const char* reg_str = skip_spaces(instruction + 2, end);
             
-            // check if brackets come before comma (this is so not the best way to do this)
-            char* bracket_start = strchr(reg_str, '[');
+            const char* bracket_start = span_find(reg_str, end, '[');
+            const char* dest_str = NULL;
             if (bracket_start && bracket_start < comma) {
                 // backwards -> LD [Rm], Rn
-                char* bracket_end = strchr(bracket_start + 1, ']');
-                if (bracket_end) {
-                    char* addr_str = bracket_start + 1;
-                    while (*addr_str == ' ') addr_str++;
-                    
-                    char* dest_reg_str = comma + 1;
-                    while (*dest_reg_str == ' ') dest_reg_str++;
-                    
-                    int dest_reg = parse_register(dest_reg_str);
-                    if (dest_reg >= 1 && dest_reg <= 6) {
-                        if (addr_str[0] == 'R') {
-                            int addr_reg = parse_register(addr_str);
-                            if (addr_reg >= 1 && addr_reg <= 6) {
-                                uint32_t mem_address = (uint32_t)cpu.registers[addr_reg];
-                                cycles += simulate_memory_access(mem_address);
-                                cpu.registers[dest_reg] = (int8_t)mem_address; // simplified
-                            }
-                        } else {
-                            uint32_t mem_address = atoi(addr_str);
-                            cycles += simulate_memory_access(mem_address);
-                            cpu.registers[dest_reg] = (int8_t)mem_address; // simplified
-                        }
-                    }
-                }
+                dest_str = skip_spaces(comma + 1, end);
             } else {
                 // Correct format: LD Rn, [Rm]
-                bracket_start = strchr(comma, '[');
-                if (bracket_start) {
-                    char* bracket_end = strchr(bracket_start + 1, ']');
-                    if (bracket_end) {
-                        char* addr_str = bracket_start + 1;
-                        while (*addr_str == ' ') addr_str++;
-                        
-                        int reg = parse_register(reg_str);
-                        if (reg >= 1 && reg <= 6) {
-                            if (addr_str[0] == 'R') {
-                                int addr_reg = parse_register(addr_str);
-                                if (addr_reg >= 1 && addr_reg <= 6) {
-                                    uint32_t mem_address = (uint32_t)cpu.registers[addr_reg];
-                                    cycles += simulate_memory_access(mem_address);
-                                    cpu.registers[reg] = (int8_t)mem_address; // simplified
-                                }
-                            } else {
-                                uint32_t mem_address = atoi(addr_str);
-                                cycles += simulate_memory_access(mem_address);
-                                cpu.registers[reg] = (int8_t)mem_address; // simplified
-                            }
+                bracket_start = span_find(comma, end, '[');
+                dest_str = reg_str;
+            }
+            
+            if (bracket_start && span_find(bracket_start + 1, end, ']')) {
+                const char* addr_str = skip_spaces(bracket_start + 1, end);
+                
+                int dest_reg = parse_register(dest_str, end);
+                if (dest_reg >= 1 && dest_reg <= 6) {
+                    if (addr_str < end && addr_str[0] == 'R') {
+                        int addr_reg = parse_register(addr_str, end);
+                        if (addr_reg >= 1 && addr_reg <= 6) {
+                            inst.op = OP_LD_REG;
+                            inst.rd = (uint8_t)dest_reg;
+                            inst.rs = (uint8_t)addr_reg;
                         }
+                    } else {
+                        inst.op = OP_LD_IMM;
+                        inst.rd = (uint8_t)dest_reg;
+                        inst.imm = (int8_t)span_atoi(addr_str, end);
                     }
                 }
             }
         }
     }
-    else if (strncmp(instruction, "ST", 2) == 0) {
+    else if (span_starts_with(instruction, end, "ST")) {
         // st [r3], r1
-        stats.ld_st_instructions++;
+        inst.op = OP_LDST_NOP;
         
-        char* bracket_start = strchr(instruction, '[');
+        const char* bracket_start = span_find(instruction, end, '[');
         if (bracket_start) {
-            char* bracket_end = strchr(bracket_start + 1, ']');
+            const char* bracket_end = span_find(bracket_start + 1, end, ']');
             if (bracket_end) {
-                char* comma = strchr(bracket_end, ',');
+                const char* comma = span_find(bracket_end, end, ',');
                 if (comma) {
-                    char* addr_str = bracket_start + 1;
-                    while (*addr_str == ' ') addr_str++;
-                    
-                    char* reg_str = comma + 1;
-                    while (*reg_str == ' ') reg_str++;
+                    const char* addr_str = skip_spaces(bracket_start + 1, end);
+                    const char* reg_str = skip_spaces(comma + 1, end);
                     
-                    int reg = parse_register(reg_str);
+                    int reg = parse_register(reg_str, end);
                     if (reg >= 1 && reg <= 6) {
-                        if (addr_str[0] == 'R') {
-                            int addr_reg = parse_register(addr_str);
+                        if (addr_str < end && addr_str[0] == 'R') {
+                            int addr_reg = parse_register(addr_str, end);
                             if (addr_reg >= 1 && addr_reg <= 6) {
-                                uint32_t mem_address = (uint32_t)cpu.registers[addr_reg];
-                                cycles += simulate_memory_access(mem_address);
+                                inst.op = OP_ST_REG;
+                                inst.rs = (uint8_t)addr_reg;
                             }
                         } else {
-                            uint32_t mem_address = atoi(addr_str);
-                            cycles += simulate_memory_access(mem_address);
+                            inst.op = OP_ST_IMM;
+                            inst.imm = (int8_t)span_atoi(addr_str, end);
                         }
                     }
                 }
@@ -389,79 +469,436 @@ void execute_instruction(char* line) {
         }
     }
     
+    return inst;
+}
+
+// execute one pre-decoded instruction, no string handling on this path
+void execute_instruction(const DecodedInstruction* inst) {
+    uint32_t cycles = 1;
+    stats.total_instructions++;
+    
+    switch (inst->op) {
+        case OP_MOV_IMM:
+            cpu.registers[inst->rd] = inst->imm;
+            break;
+        case OP_MOV_REG:
+            cpu.registers[inst->rd] = cpu.registers[inst->rs];
+            break;
+        case OP_ADD_IMM:
+            cpu.registers[inst->rd] += inst->imm;
+            break;
+        case OP_ADD_REG:
+            cpu.registers[inst->rd] += cpu.registers[inst->rs];
+            break;
+        case OP_CMP:
+            cpu.zero_flag = (cpu.registers[inst->rd] == cpu.registers[inst->rs]);
+            break;
+        case OP_JE:
+            if (!cpu.zero_flag) {
+                break;
+            }
+            // target already resolved, invalid targets point past the end (halt)
+            cpu.pc = (uint32_t)inst->target;
+            stats.total_cycles += cycles;
+            return; // don't increment pc normally
+        case OP_JMP:
+            cpu.pc = (uint32_t)inst->target;
+            stats.total_cycles += cycles;
+            return; // don't increment pc normally
+        case OP_LD_REG:
+            {
+                uint32_t mem_address = (uint32_t)cpu.registers[inst->rs];
+                cycles += simulate_memory_access(mem_address);
+                cpu.registers[inst->rd] = (int8_t)mem_address; // simplified
+            }
+            stats.ld_st_instructions++;
+            break;
+        case OP_LD_IMM:
+            cycles += simulate_memory_access((uint8_t)inst->imm);
+            cpu.registers[inst->rd] = inst->imm; // simplified
+            stats.ld_st_instructions++;
+            break;
+        case OP_ST_REG:
+            cycles += simulate_memory_access((uint32_t)cpu.registers[inst->rs]);
+            stats.ld_st_instructions++;
+            break;
+        case OP_ST_IMM:
+            cycles += simulate_memory_access((uint8_t)inst->imm);
+            stats.ld_st_instructions++;
+            break;
+        case OP_LDST_NOP:
+            stats.ld_st_instructions++;
+            break;
+        default:
+            break;
+    }
+    
     // increment program counter for non-jump instructions
     cpu.pc++;
     stats.total_cycles += cycles;
 }
 
+// State-repetition detection. Registers, zero flag, pc and residency bitmap
+// are the whole architectural state, so once one repeats at a backward branch
+// the run is periodic and the counters can be extrapolated to the limit.
+#define CYCLE_TABLE_SIZE 16384   // power of two, cleared when half full
+
+typedef struct {
+    uint64_t resident[LOCAL_MEMORY_SIZE / 64];
+    int8_t registers[7];
+    uint8_t zero_flag;
+    uint32_t pc;
+    uint32_t padding;            // keeps memcmp/hash well defined
+} MachineState;
+
+typedef struct {
+    MachineState state;
+    SimulatorStats stats;        // counters when the state was seen
+    uint32_t generation;         // slot is live when equal to cycle_generation
+} CycleEntry;
+
+int detect_cycles = 0;
+CycleEntry* cycle_table = NULL;
+uint32_t cycle_table_used = 0;
+uint32_t cycle_generation = 0;
+
+void capture_state(MachineState* state) {
+    memset(state, 0, sizeof(*state));
+    memcpy(state->resident, cache.resident, sizeof(state->resident));
+    memcpy(state->registers, cpu.registers, sizeof(state->registers));
+    state->zero_flag = cpu.zero_flag;
+    state->pc = cpu.pc;
+}
+
+uint64_t hash_state(const MachineState* state) {
+    uint64_t words[sizeof(MachineState) / 8];
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    memcpy(words, state, sizeof(words));
+    for (size_t i = 0; i < sizeof(words) / 8; i++) {
+        h ^= words[i];
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// O(1) clear: bumping the generation retires every slot, and calloc keeps
+// untouched pages from ever being faulted in
+void clear_cycle_table() {
+    if (!cycle_table) {
+        cycle_table = calloc(CYCLE_TABLE_SIZE, sizeof(CycleEntry));
+        if (!cycle_table) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    cycle_generation++;
+    cycle_table_used = 0;
+}
+
+// returns the entry recorded for an identical earlier state, or records
+// this one and returns NULL
+const CycleEntry* find_or_record_state() {
+    MachineState state;
+    capture_state(&state);
+    
+    uint32_t h = (uint32_t)hash_state(&state) & (CYCLE_TABLE_SIZE - 1);
+    while (cycle_table[h].generation == cycle_generation) {
+        if (memcmp(&cycle_table[h].state, &state, sizeof(state)) == 0) {
+            return &cycle_table[h];
+        }
+        h = (h + 1) & (CYCLE_TABLE_SIZE - 1);
+    }
+    
+    if (cycle_table_used >= CYCLE_TABLE_SIZE / 2) {
+        // long transient, start over, detection is only delayed
+        clear_cycle_table();
+        h = (uint32_t)hash_state(&state) & (CYCLE_TABLE_SIZE - 1);
+    }
+    cycle_table[h].state = state;
+    cycle_table[h].stats = stats;
+    cycle_table[h].generation = cycle_generation;
+    cycle_table_used++;
+    return NULL;
+}
+
+// worst case of run_block from every record, filled back to front. A run
+// goes on past a JE that is not taken and a jump to the next record, so
+// only any other JMP and the last record end one
+void build_run_bounds() {
+    for (int i = global_line_count - 1; i >= 0; i--) {
+        const DecodedInstruction* inst = &global_program[i];
+        uint64_t cost = 1;
+        if (inst->op >= OP_LD_REG && inst->op <= OP_ST_IMM) {
+            cost += CACHE_MISS_CYCLES;
+        }
+        global_run_bounds[i].instructions = 1;
+        global_run_bounds[i].cycles = cost;
+        if (i + 1 < global_line_count && !(inst->op == OP_JMP && inst->target != i + 1)) {
+            global_run_bounds[i].instructions += global_run_bounds[i + 1].instructions;
+            global_run_bounds[i].cycles += global_run_bounds[i + 1].cycles;
+        }
+    }
+}
+
+// run straight-line code from pc up to the next taken branch or the end,
+// returns the pc of the last instruction executed
+uint32_t run_block() {
+    uint32_t pc;
+    do {
+        pc = cpu.pc;
+        execute_instruction(&global_program[pc]);
+    } while (cpu.pc == pc + 1 && cpu.pc < (uint32_t)global_line_count);
+    return pc;
+}
+
+// next block, or only its first instruction when the whole block could
+// cross a limit, so the budget stops a run at the exact instruction.
+// Counters must be below both limits. Returns the pc of the last
+// instruction executed
+uint32_t run_within_budget(uint64_t instruction_limit, uint64_t cycle_limit) {
+    const RunBound* bound = &global_run_bounds[cpu.pc];
+    if (instruction_limit - stats.total_instructions < bound->instructions ||
+        cycle_limit - stats.total_cycles < bound->cycles) {
+        uint32_t pc = cpu.pc;
+        execute_instruction(&global_program[pc]);
+        return pc;
+    }
+    return run_block();
+}
+
+// Run until halt or the budget, skipping whole periods once the state
+// repeats. Results are identical to the plain loop. Without a budget a
+// repeated state means the program never halts, so the run stops there.
+void run_with_cycle_detection(uint64_t instruction_limit, uint64_t cycle_limit) {
+    int detecting = 1;
+    
+    clear_cycle_table();
+    while (cpu.pc < (uint32_t)global_line_count) {
+        if (stats.total_instructions >= instruction_limit || stats.total_cycles >= cycle_limit) {
+            budget_exhausted = 1;
+            break;
+        }
+        uint32_t pc_before = run_within_budget(instruction_limit, cycle_limit);
+        
+        // only taken backward branches can close a cycle
+        if (!detecting || cpu.pc > pc_before) {
+            continue;
+        }
+        const CycleEntry* seen = find_or_record_state();
+        if (!seen) {
+            continue;
+        }
+        if (!max_instructions && !max_cycles) {
+            never_halts = 1;
+            break;
+        }
+        // whole periods that still end within both limits, so the run stops
+        // at the same instruction as the plain loop would
+        uint64_t period_instructions = stats.total_instructions - seen->stats.total_instructions;
+        uint64_t period_cycles = stats.total_cycles - seen->stats.total_cycles;
+        uint64_t periods = 0;
+        if (stats.total_instructions < instruction_limit && stats.total_cycles < cycle_limit) {
+            periods = (instruction_limit - stats.total_instructions) / period_instructions;
+            uint64_t cycle_periods = (cycle_limit - stats.total_cycles) / period_cycles;
+            if (cycle_periods < periods) {
+                periods = cycle_periods;
+            }
+        }
+        stats.total_instructions += periods * period_instructions;
+        stats.total_cycles += periods * period_cycles;
+        stats.memory_hits += periods * (stats.memory_hits - seen->stats.memory_hits);
+        stats.ld_st_instructions += periods * (stats.ld_st_instructions - seen->stats.ld_st_instructions);
+        detecting = 0; // the remainder is shorter than one period
+    }
+}
+
 // optimized file processing
 void process_assembly_file(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file %s\n", filename);
+    SourceText text;
+    if (source_open(&text, filename) != 0) {
         exit(1);
     }
     
-    // reset global arrays
+    // reset global arrays and machine state
     global_line_count = 0;
+    reset_simulator();
     
-    // read all lines
-    while (fgets(global_lines[global_line_count], sizeof(global_lines[global_line_count]), file) && global_line_count < 1000) {
-        // remove newline efficiently
-        int len = strlen(global_lines[global_line_count]);
-        if (len > 0 && global_lines[global_line_count][len-1] == '\n') {
-            global_lines[global_line_count][len-1] = '\0';
-            len--;
-        }
-        
+    // every line is decoded straight from the mapped file, no copies and
+    // no limit on line length or count; kept lines never outnumber lines
+    size_t lines = source_count_lines(&text);
+    if (lines > (size_t)INT32_MAX) {
+        fprintf(stderr, "Error: program too large\n");
+        exit(1);
+    }
+    free(program_arena);
+    program_arena = malloc((lines ? lines : 1) * (sizeof(RunBound) + sizeof(DecodedInstruction) + 2 * sizeof(int)));
+    if (!program_arena) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    global_run_bounds = program_arena;
+    global_program = (DecodedInstruction*)(global_run_bounds + lines);
+    global_line_numbers = (int*)(global_program + lines);
+    global_target_lines = global_line_numbers + lines;
+    
+    const char* cursor = text.data;
+    const char* line;
+    const char* line_end;
+    while ((line = source_next_line(&text, &cursor, &line_end)) != NULL) {
         // skip empty lines, comments, and labels quickly
-        if (len == 0 || global_lines[global_line_count][0] == '#' || global_lines[global_line_count][0] == ';' || global_lines[global_line_count][len-1] == ':') {
+        if (line == line_end || line[0] == '#' || line[0] == ';' || line_end[-1] == ':') {
             continue;
         }
         
         // extract line number from the beginning of the line
-        char* ptr = global_lines[global_line_count];
-        while (*ptr == ' ' || *ptr == '\t') ptr++;
-        int line_num = atoi(ptr);
+        int line_num = span_atoi(line, line_end);
         
         // If no explicit line number found, use 1-based line numbering
         if (line_num == 0) {
             line_num = global_line_count + 1; // 1-based line number
         }
         global_line_numbers[global_line_count] = line_num;
-        
+        global_program[global_line_count] = decode_instruction(line, line_end, &global_target_lines[global_line_count]);
         global_line_count++;
     }
     
-    fclose(file);
+    source_close(&text);
     
-    // execute instructions using program counter with reasonable limit
+    // resolve branch targets against the full table
+    build_line_index();
+    for (int i = 0; i < global_line_count; i++) {
+        if (global_program[i].op == OP_JE || global_program[i].op == OP_JMP) {
+            int target_index = find_instruction_index(global_target_lines[i]);
+            if (target_index < 0) {
+                // flagged once here instead of on every execution
+                fprintf(stderr, "Warning: line %d jumps to unknown line %d, treated as halt\n",
+                        global_line_numbers[i], global_target_lines[i]);
+                target_index = global_line_count; // invalid jump target, halt!
+            }
+            global_program[i].target = target_index;
+        }
+    }
+    build_run_bounds();
+    
+    // execute instructions using program counter, the budget is checked
+    // once per block until the next block could cross it
     cpu.pc = 0;
-    uint32_t instruction_limit = 100000; // reasonable limit for performance testing
-    uint32_t instruction_count = 0;
+    budget_exhausted = 0;
+    never_halts = 0;
+    uint64_t instruction_limit = max_instructions ? max_instructions : UINT64_MAX;
+    uint64_t cycle_limit = max_cycles ? max_cycles : UINT64_MAX;
+    
+    // the cache model's replacement state is not part of MachineState
+    if (detect_cycles && !cache_model_enabled) {
+        run_with_cycle_detection(instruction_limit, cycle_limit);
+        return;
+    }
     
-    while (cpu.pc < (uint32_t)global_line_count && instruction_count < instruction_limit) {
-        execute_instruction(global_lines[cpu.pc]);
-        instruction_count++;
+    while (cpu.pc < (uint32_t)global_line_count) {
+        if (stats.total_instructions >= instruction_limit || stats.total_cycles >= cycle_limit) {
+            budget_exhausted = 1;
+            break;
+        }
+        run_within_budget(instruction_limit, cycle_limit);
     }
 }
 
 // optimized results printing
 void print_results() {
-    printf("Total number of executed instructions: %u\n", stats.total_instructions);
-    printf("Total number of clock cycles: %u\n", stats.total_cycles);
-    printf("Number of hits to local memory: %u\n", stats.memory_hits);
-    printf("Total number of executed LD/ST instructions: %u\n", stats.ld_st_instructions);
+    printf("Total number of executed instructions: %" PRIu64 "\n", stats.total_instructions);
+    printf("Total number of clock cycles: %" PRIu64 "\n", stats.total_cycles);
+    printf("Number of hits to local memory: %" PRIu64 "\n", stats.memory_hits);
+    printf("Total number of executed LD/ST instructions: %" PRIu64 "\n", stats.ld_st_instructions);
+    if (budget_exhausted) {
+        fprintf(stderr, "Warning: run budget reached, stopped before the program halted\n");
+    }
+    if (never_halts) {
+        fprintf(stderr, "Warning: machine state repeats, the program never halts\n");
+    }
+}
+
+// budget value: a count, or 0 / "unlimited" for no limit
+int parse_budget(const char* text, uint64_t* value) {
+    char* end;
+    if (strcmp(text, "unlimited") == 0) {
+        *value = 0;
+        return 0;
+    }
+    errno = 0;
+    *value = strtoull(text, &end, 10);
+    return (end == text || *end != '\0' || errno != 0 || text[0] == '-') ? -1 : 0;
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <assembly_file> [more_assembly_files...]\n", program);
+    fprintf(stderr, "Cache model options (default 256 B, 1 B lines, direct mapped, lru):\n");
+    fprintf(stderr, "  --cache-size N   --line-size N   --assoc N\n");
+    fprintf(stderr, "  --policy lru|fifo|random|plru    --cache-stats\n");
+    fprintf(stderr, "Run budget, checked once per basic block (default %d instructions, cycles unlimited):\n",
+            DEFAULT_MAX_INSTRUCTIONS);
+    fprintf(stderr, "  --max-instructions N|unlimited   --max-cycles N|unlimited\n");
+    fprintf(stderr, "  --detect-cycles  skip repeated states up to the budget\n");
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <assembly_file>\n", argv[0]);
+    int print_cache_stats = 0;
+    int first_file = 1;
+    CacheConfig cache_config;
+    cache_config_default(&cache_config);
+    
+    // options come before the file list
+    while (first_file < argc && strncmp(argv[first_file], "--", 2) == 0) {
+        if (strcmp(argv[first_file], "--detect-cycles") == 0) {
+            detect_cycles = 1;
+            first_file++;
+            continue;
+        }
+        if ((strcmp(argv[first_file], "--max-instructions") == 0 || strcmp(argv[first_file], "--max-cycles") == 0) &&
+            first_file + 1 < argc) {
+            uint64_t* limit = (argv[first_file][6] == 'i') ? &max_instructions : &max_cycles;
+            if (parse_budget(argv[first_file + 1], limit) != 0) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+            first_file += 2;
+            continue;
+        }
+        if (strcmp(argv[first_file], "--cache-stats") == 0) {
+            print_cache_stats = 1;
+            cache_model_enabled = 1;
+            first_file++;
+            continue;
+        }
+        const char* value = first_file + 1 < argc ? argv[first_file + 1] : NULL;
+        if (cache_parse_option(&cache_config, argv[first_file], value) <= 0) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        cache_model_enabled = 1;
+        first_file += 2;
+    }
+    if (first_file >= argc) {
+        print_usage(argv[0]);
+        exit(1);
+    }
+    if (cache_model_enabled && cache_model_init(&cache_model, &cache_config) != 0) {
         exit(1);
     }
     
-    process_assembly_file(argv[1]);
-    print_results();
+    // every file runs from a clean simulator state
+    for (int i = first_file; i < argc; i++) {
+        process_assembly_file(argv[i]);
+        print_results();
+        if (print_cache_stats) {
+            cache_model_print_stats(&cache_model, stdout);
+        }
+    }
     
+    if (cache_model_enabled) {
+        cache_model_free(&cache_model);
+    }
+    free(cycle_table);
+    free(program_arena);
     return 0;
 }
@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lanes.h"
+
+// parse one "Rn=value" or "[addr]=value" list into state, -1 on a bad token
+static int parse_state(char* line, IssLaneState* state) {
+    memset(state, 0, sizeof(*state));
+    for (char* token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        char* equals = strchr(token, '=');
+        if (!equals) {
+            return -1;
+        }
+        char* end = NULL;
+        long value = strtol(equals + 1, &end, 0);
+        if (end == equals + 1 || *end != '\0' || value < -128 || value > 255) {
+            return -1;
+        }
+        if (token[0] == 'R' && token[1] >= '1' && token[1] <= '6' && token + 2 == equals) {
+            state->registers[token[1] - '1'] = (int8_t)value;
+        } else if (token[0] == '[' && equals[-1] == ']') {
+            long addr = strtol(token + 1, &end, 0);
+            if (end == token + 1 || end != equals - 1 || addr < 0 || addr > 255) {
+                return -1;
+            }
+            state->memory[addr] = (uint8_t)value;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int read_states(const char* path, IssLaneState** states, int* count) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open file %s\n", path);
+        return -1;
+    }
+    int capacity = 0;
+    int line_number = 0;
+    int failed = 0;
+    char* line = NULL;
+    size_t size = 0;
+    *states = NULL;
+    *count = 0;
+    while (getline(&line, &size, file) != -1) {
+        line_number++;
+        if (line[strspn(line, " \t\r\n")] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (*count == capacity) {
+            int grown = capacity ? capacity * 2 : 64;
+            IssLaneState* resized = realloc(*states, (size_t)grown * sizeof(IssLaneState));
+            if (!resized) {
+                fprintf(stderr, "Memory allocation failed\n");
+                failed = 1;
+                break;
+            }
+            *states = resized;
+            capacity = grown;
+        }
+        if (parse_state(line, &(*states)[*count]) != 0) {
+            fprintf(stderr, "Error: %s:%d: expected Rn=value or [addr]=value assignments\n", path, line_number);
+            failed = 1;
+            break;
+        }
+        (*count)++;
+    }
+    // a bad last line without a newline leaves the file at end too
+    int ok = !failed && feof(file);
+    free(line);
+    fclose(file);
+    return ok ? 0 : -1;
+}
+
+int run_lanes(const char* filename, const IssOptions* options, const char* states_path, BatchFormat format) {
+    IssLaneState* states = NULL;
+    int count = 0;
+    if (read_states(states_path, &states, &count) != 0) {
+        free(states);
+        return 1;
+    }
+
+    IssContext* ctx = iss_create(options);
+    if (!ctx || iss_load_file(ctx, filename) != 0) {
+        iss_destroy(ctx);
+        free(states);
+        return -1;
+    }
+    IssStats* stats = calloc(count > 0 ? (size_t)count : 1, sizeof(IssStats));
+    if (!stats) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    int result = iss_run_lanes(ctx, states, count, stats);
+
+    if (result == 0) {
+        if (format == BATCH_FORMAT_CSV) {
+            printf("lane,executed_instructions,clock_cycles,local_memory_hits,ld_st_instructions\n");
+        }
+        for (int k = 0; k < count; k++) {
+            printf(format == BATCH_FORMAT_JSON ?
+                   "{\"lane\":%d,\"executed_instructions\":%lld,\"clock_cycles\":%lld,"
+                   "\"local_memory_hits\":%lld,\"ld_st_instructions\":%lld}\n" :
+                   "%d,%lld,%lld,%lld,%lld\n",
+                   k, stats[k].executed_instructions, stats[k].clock_cycles,
+                   stats[k].local_memory_hits, stats[k].memory_instructions);
+        }
+        for (int k = 0; k < count; k++) {
+            if (stats[k].budget_exhausted) {
+                fprintf(stderr, "Warning: lane %d stopped at the run budget\n", k);
+            }
+        }
+    }
+
+    free(stats);
+    iss_destroy(ctx);
+    free(states);
+    return result == 0 ? 0 : 1;
+}
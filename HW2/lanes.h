@@ -0,0 +1,17 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include "iss.h"
+#include "batch.h"
+
+// Lane mode: run one program over every initial state listed in a text
+// file with the SIMD lane engine (iss_run_lanes) and print one result row
+// per state. Each line is one state, whitespace-separated assignments
+// such as "R1=5 R3=-2 [16]=7"; registers and memory not named start at 0.
+// Blank lines and lines starting with '#' are skipped.
+
+// returns 0 on success, 1 on a bad state file or unsupported program, -1
+// if the program could not be loaded
+int run_lanes(const char* filename, const IssOptions* options, const char* states_path, BatchFormat format);
+
+#endif
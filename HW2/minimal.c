@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iss.h"
+
+// Minimal-startup front end (make minimal), for single-shot runs where
+// process startup is most of the cost. Linked statically, so there is no
+// dynamic loader or relocation pass, and the result path never touches
+// stdio: the program is mapped by source_open, the four result lines are
+// formatted by hand into one buffer and leave in a single write. stdio is
+// only initialized on the error paths of the core. Same output as
+// `myISS <assembly_file>`; every other mode stays in myISS.
+
+// append text, returns the end
+static char* put_text(char* pos, const char* text) {
+    size_t length = strlen(text);
+    memcpy(pos, text, length);
+    return pos + length;
+}
+
+// append a decimal count and a newline, returns the end
+static char* put_count(char* pos, long long value) {
+    char digits[24];
+    int n = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        *pos++ = '-';
+    }
+    while (n > 0) {
+        *pos++ = digits[--n];
+    }
+    *pos++ = '\n';
+    return pos;
+}
+
+static int write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0) {
+            return -1;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+static int usage(const char* program) {
+    static const char options[] = " [--max-instructions N] [--max-cycles N] <assembly_file>\n";
+    write_all(2, "Usage: ", 7);
+    write_all(2, program, strlen(program));
+    write_all(2, options, sizeof(options) - 1);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* filename = NULL;
+    IssOptions options;
+    iss_options_default(&options);
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--max-instructions") == 0 || strcmp(argv[i], "--max-cycles") == 0) && i + 1 < argc) {
+            long long* limit = (argv[i][6] == 'i') ? &options.max_instructions : &options.max_cycles;
+            char* end;
+            *limit = strtoll(argv[++i], &end, 10);
+            if (*end != '\0' || *limit < 0) {
+                return usage(argv[0]);
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0 || filename) {
+            return usage(argv[0]);
+        } else {
+            filename = argv[i];
+        }
+    }
+    if (!filename) {
+        return usage(argv[0]);
+    }
+
+    IssContext* ctx = iss_create(&options);
+    if (!ctx || iss_load_file(ctx, filename) != 0) {
+        return 1;
+    }
+    iss_run(ctx);
+    IssStats stats;
+    iss_get_stats(ctx, &stats);
+
+    char output[256];
+    char* pos = output;
+    pos = put_text(pos, "Total number of executed instructions: ");
+    pos = put_count(pos, stats.executed_instructions);
+    pos = put_text(pos, "Total number of clock cycles: ");
+    pos = put_count(pos, stats.clock_cycles);
+    pos = put_text(pos, "Number of hits to local memory: ");
+    pos = put_count(pos, stats.local_memory_hits);
+    pos = put_text(pos, "Total number of executed LD/ST instructions: ");
+    pos = put_count(pos, stats.memory_instructions);
+    if (write_all(1, output, (size_t)(pos - output)) != 0) {
+        return 1;
+    }
+    if (stats.budget_exhausted) {
+        static const char warning[] = "Warning: run budget reached, stopped before the program halted\n";
+        write_all(2, warning, sizeof(warning) - 1);
+    }
+    // the process exit releases the context, no teardown pass
+    return 0;
+}
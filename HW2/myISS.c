@@ -1,437 +1,451 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdint.h>
+#include <errno.h>
 
-#define MAX_LINE_LENGTH 256
-#define CACHE_HIT_CYCLES 2
-#define CACHE_MISS_CYCLES 50
-#define LOCAL_MEMORY_SIZE 256
+#include "iss.h"
+#include "batch.h"
+#include "serve.h"
+#include "sweep.h"
+#include "lanes.h"
 
-// Instruction types
-typedef enum {
-    MOV_REG_IMM = 0,
-    MOV_REG_REG = 1,
-    ADD_REG_REG = 2,
-    ADD_REG_IMM = 3,
-    CMP_REG_REG = 4,
-    JE_ADDR = 5,
-    JMP_ADDR = 6,
-    LD_REG_REG = 7,
-    ST_REG_REG = 8,
-    LD_REV_REG_REG = 9,  // backward format: LD [Rm], Rn
-    INVALID = 10
-} InstructionType;
+// Command-line front end, the simulator itself lives in iss.c (libiss)
 
-// Pre-decoded instruction
-typedef struct {
-    InstructionType type;
-    int arg1;  // register number or address
-    int arg2;  // register number or immediate value
-} Instruction;
-
-// Memory simulation
-typedef struct {
-    uint8_t memory[256];
-    uint8_t touched[256];  // track which addresses have been accessed
-} Memory;
-
-// CPU simulation
-typedef struct {
-    int8_t registers[7]; // R1-R6 (index 1-6), index 0 unused
-    uint8_t zero_flag; // for cmp instruction
-} CPU;
-
-// global variables
-Memory memory = {0};
-CPU cpu = {0};
-Instruction* instructions = NULL;
-int instruction_count = 0;
-int first_line_number = 0;
+// Print the four result counters
+void print_results(long long executed_instructions, long long clock_cycles, long long local_memory_hits,
+                   long long total_memory_hits) {
+    printf("Total number of executed instructions: %lld\n", executed_instructions);
+    printf("Total number of clock cycles: %lld\n", clock_cycles);
+    printf("Number of hits to local memory: %lld\n", local_memory_hits);
+    printf("Total number of executed LD/ST instructions: %lld\n", total_memory_hits);
+}
 
-// Parse integer from string
-int parse_int(const char* str) {
-    return atoi(str);
+// budget value: a count, or 0 / "unlimited" for no limit
+static int parse_budget(const char* text, long long* value) {
+    char* end;
+    if (strcmp(text, "unlimited") == 0) {
+        *value = 0;
+        return 0;
+    }
+    errno = 0;
+    *value = strtoll(text, &end, 10);
+    return (end == text || *end != '\0' || errno != 0 || *value < 0) ? -1 : 0;
 }
 
-// Parse register number from string like "R1"
-int parse_register(const char* str) {
-    if (str[0] == 'R') {
-        return atoi(str + 1);
+// Run to the end (or the user's budget), saving a checkpoint at the first
+// stop point and then every `every` instructions, each one replacing the
+// last. Returns the number written, -1 on failure.
+static int run_checkpointed(IssContext* ctx, const IssOptions* options, const char* path,
+                            long long at, int at_pc, long long every) {
+    IssStats stats;
+    iss_get_stats(ctx, &stats);
+    long long next = at > 0 ? at : (every > 0 ? stats.executed_instructions + every : 0);
+    int stop_pc = at_pc;
+    int written = 0;
+    for (;;) {
+        long long limit = options->max_instructions;
+        if (next > 0 && (limit == 0 || next < limit)) {
+            limit = next;
+        }
+        iss_set_budget(ctx, limit, options->max_cycles, stop_pc);
+        if (iss_resume(ctx) != 0) {
+            return -1;
+        }
+        iss_get_stats(ctx, &stats);
+        // the program halted, or the user's own budget ran out
+        if (!stats.stopped_at_pc &&
+            (!stats.budget_exhausted ||
+             (options->max_instructions > 0 && stats.executed_instructions >= options->max_instructions) ||
+             (options->max_cycles > 0 && stats.clock_cycles >= options->max_cycles))) {
+            break;
+        }
+        if (iss_save_checkpoint(ctx, path) != 0) {
+            return -1;
+        }
+        written++;
+        stop_pc = -1;
+        next = every > 0 ? stats.executed_instructions + every : 0;
     }
-    return -1;
+    iss_set_budget(ctx, options->max_instructions, options->max_cycles, -1);
+    return written;
 }
 
-// Parse instruction from a line
-Instruction parse_instruction_line(char* line) {
-    Instruction inst = {INVALID, 0, 0};
-    
-    // Skip leading whitespace and line number
-    char* ptr = line;
-    while (*ptr == ' ' || *ptr == '\t') ptr++;
-    while (*ptr >= '0' && *ptr <= '9') ptr++;
-    while (*ptr == ' ' || *ptr == '\t') ptr++;
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <assembly_file>\n", program);
+    fprintf(stderr, "       %s [options] --batch <directory|list_file> [--jobs N] [--format csv|json]\n", program);
+    fprintf(stderr, "       %s [options] --sweep-hit A:B[:S] --sweep-miss A:B[:S] --sweep-size A:B <assembly_file>\n", program);
+    fprintf(stderr, "       %s --assemble <output.issbin> <assembly_file>\n", program);
+    fprintf(stderr, "       %s [options] --emit-c <output.c> <assembly_file>\n", program);
+    fprintf(stderr, "       %s [options] --lanes <state_file> [--format csv|json] <assembly_file>\n", program);
+    fprintf(stderr, "       %s [options] --replay <trace_file>\n", program);
+    fprintf(stderr, "       %s [options] --serve <socket> [--jobs N]\n", program);
+    fprintf(stderr, "Run budget, checked once per basic block (default unlimited):\n");
+    fprintf(stderr, "  --max-instructions N|unlimited   --max-cycles N|unlimited\n");
+    fprintf(stderr, "Checkpoints, taken at a block entry (the run then continues to the end):\n");
+    fprintf(stderr, "  --checkpoint <file> with --checkpoint-at N, --checkpoint-pc LINE and/or\n");
+    fprintf(stderr, "  --checkpoint-every N (instructions)   --resume <file>\n");
+    fprintf(stderr, "Execution trace (--replay re-costs it under the latency and cache options):\n");
+    fprintf(stderr, "  --trace <trace_file>\n");
+    fprintf(stderr, "LD/ST latencies (default %d and %d extra cycles):\n", CACHE_HIT_CYCLES, CACHE_MISS_CYCLES);
+    fprintf(stderr, "  --hit-cycles N   --miss-cycles N\n");
+    fprintf(stderr, "Cache model options (default 256 B, 1 B lines, direct mapped, lru):\n");
+    fprintf(stderr, "  --cache-size N   --line-size N   --assoc N\n");
+    fprintf(stderr, "  --policy lru|fifo|random|plru    --cache-stats\n");
+    fprintf(stderr, "Superinstruction fusion (CMP+JE, CMP+JE+JMP, ADD+ADD, LD+ADD):\n");
+    fprintf(stderr, "  --no-fusion      --fusion-stats\n");
+    fprintf(stderr, "  --no-fast-forward  execute counted loops instead of solving them\n");
+#ifdef JIT_BACKEND
+    fprintf(stderr, "  --no-jit         run the interpreter instead of the JIT\n");
+#endif
+#ifdef ISS_PROFILE
+    fprintf(stderr, "Per-PC profile, hottest first (default top 20, 0 for all):\n");
+    fprintf(stderr, "  --profile        --profile-top N\n");
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    const char* filename = NULL;
+    const char* batch_path = NULL;
+    int batch_jobs = 0;
+    BatchFormat batch_format = BATCH_FORMAT_CSV;
+    int format_given = 0;
+    const char* sweep_hit = NULL;
+    const char* sweep_miss = NULL;
+    const char* sweep_size = NULL;
+    const char* lanes_path = NULL;
+    const char* assemble_path = NULL;
+    const char* emit_path = NULL;
+    const char* trace_path = NULL;
+    const char* replay_path = NULL;
+    const char* serve_path = NULL;
+    const char* checkpoint_path = NULL;
+    const char* resume_path = NULL;
+    long long checkpoint_at = 0;
+    long long checkpoint_every = 0;
+    int checkpoint_pc = -1;
+    int print_cache_stats = 0;
+    int print_fusion_stats_flag = 0;
+#ifdef ISS_PROFILE
+    int print_profile = 0;
+    int profile_top = 20;
+#endif
+    IssOptions options;
+    iss_options_default(&options);
     
-    // Parse instruction mnemonic
-    if (strncmp(ptr, "MOV", 3) == 0) {
-        ptr += 3;
-        while (*ptr == ' ') ptr++;
-        
-        int reg = parse_register(ptr);
-        if (reg >= 1 && reg <= 6) {
-            char* comma = strchr(ptr, ',');
-            if (comma) {
-                comma++;
-                while (*comma == ' ') comma++;
-                
-                if (comma[0] == 'R') {
-                    // MOV Rn, Rm - treat as MOV with immediate from register
-                    int src_reg = parse_register(comma);
-                    if (src_reg >= 1 && src_reg <= 6) {
-                        inst.type = MOV_REG_IMM;
-                        inst.arg1 = reg;
-                        inst.arg2 = 0; // will be resolved at execution
-                    }
-                } else {
-                    inst.type = MOV_REG_IMM;
-                    inst.arg1 = reg;
-                    inst.arg2 = parse_int(comma);
-                }
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            if (filename) {
+                print_usage(argv[0]);
+                exit(1);
             }
+            filename = argv[i];
+            continue;
         }
-    }
-    else if (strncmp(ptr, "ADD", 3) == 0) {
-        ptr += 3;
-        while (*ptr == ' ') ptr++;
-        
-        int reg = parse_register(ptr);
-        if (reg >= 1 && reg <= 6) {
-            char* comma = strchr(ptr, ',');
-            if (comma) {
-                comma++;
-                while (*comma == ' ') comma++;
-                
-                if (comma[0] == 'R') {
-                    inst.type = ADD_REG_REG;
-                    inst.arg1 = reg;
-                    inst.arg2 = parse_register(comma);
-                } else {
-                    inst.type = ADD_REG_IMM;
-                    inst.arg1 = reg;
-                    inst.arg2 = parse_int(comma);
-                }
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            batch_jobs = atoi(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            format_given = 1;
+            if (strcmp(argv[i], "csv") == 0) {
+                batch_format = BATCH_FORMAT_CSV;
+            } else if (strcmp(argv[i], "json") == 0) {
+                batch_format = BATCH_FORMAT_JSON;
+            } else {
+                print_usage(argv[0]);
+                exit(1);
             }
+            continue;
         }
-    }
-    else if (strncmp(ptr, "CMP", 3) == 0) {
-        ptr += 3;
-        while (*ptr == ' ') ptr++;
-        
-        int reg1 = parse_register(ptr);
-        if (reg1 >= 1 && reg1 <= 6) {
-            char* comma = strchr(ptr, ',');
-            if (comma) {
-                comma++;
-                while (*comma == ' ') comma++;
-                
-                int reg2 = parse_register(comma);
-                if (reg2 >= 1 && reg2 <= 6) {
-                    inst.type = CMP_REG_REG;
-                    inst.arg1 = reg1;
-                    inst.arg2 = reg2;
-                }
+        if (strcmp(argv[i], "--hit-cycles") == 0 && i + 1 < argc) {
+            options.hit_cycles = atoi(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--miss-cycles") == 0 && i + 1 < argc) {
+            options.miss_cycles = atoi(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--max-instructions") == 0 || strcmp(argv[i], "--max-cycles") == 0) && i + 1 < argc) {
+            long long* limit = (argv[i][6] == 'i') ? &options.max_instructions : &options.max_cycles;
+            if (parse_budget(argv[++i], limit) != 0) {
+                print_usage(argv[0]);
+                exit(1);
             }
+            continue;
         }
-    }
-    else if (strncmp(ptr, "JE", 2) == 0) {
-        ptr += 2;
-        while (*ptr == ' ') ptr++;
-        
-        inst.type = JE_ADDR;
-        inst.arg1 = parse_int(ptr);
-        inst.arg2 = 0;
-    }
-    else if (strncmp(ptr, "JMP", 3) == 0) {
-        ptr += 3;
-        while (*ptr == ' ') ptr++;
-        
-        inst.type = JMP_ADDR;
-        inst.arg1 = parse_int(ptr);
-        inst.arg2 = 0;
-    }
-    else if (strncmp(ptr, "LD", 2) == 0) {
-        ptr += 2;
-        while (*ptr == ' ') ptr++;
-        
-        // Check if brackets come before comma (backward format)
-        char* comma = strchr(ptr, ',');
-        char* bracket_start = strchr(ptr, '[');
-        
-        if (comma && bracket_start && bracket_start < comma) {
-            // LD [Rm], Rn - backward format
-            bracket_start++;
-            while (*bracket_start == ' ') bracket_start++;
-            
-            int addr_reg = parse_register(bracket_start);
-            if (addr_reg >= 1 && addr_reg <= 6) {
-                comma++;
-                while (*comma == ' ') comma++;
-                
-                int dest_reg = parse_register(comma);
-                if (dest_reg >= 1 && dest_reg <= 6) {
-                    inst.type = LD_REV_REG_REG;
-                    inst.arg1 = addr_reg;
-                    inst.arg2 = dest_reg;
-                }
+        if (strcmp(argv[i], "--assemble") == 0 && i + 1 < argc) {
+            assemble_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc) {
+            emit_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            resume_path = argv[++i];
+            continue;
+        }
+        if ((strcmp(argv[i], "--checkpoint-at") == 0 || strcmp(argv[i], "--checkpoint-every") == 0) && i + 1 < argc) {
+            long long* count = (argv[i][13] == 'a') ? &checkpoint_at : &checkpoint_every;
+            if (parse_budget(argv[++i], count) != 0) {
+                print_usage(argv[0]);
+                exit(1);
             }
-        } else {
-            // LD Rn, [Rm] - normal format
-            int reg = parse_register(ptr);
-            if (reg >= 1 && reg <= 6) {
-                comma = strchr(ptr, ',');
-                if (comma) {
-                    bracket_start = strchr(comma, '[');
-                    if (bracket_start) {
-                        bracket_start++;
-                        while (*bracket_start == ' ') bracket_start++;
-                        
-                        int addr_reg = parse_register(bracket_start);
-                        if (addr_reg >= 1 && addr_reg <= 6) {
-                            inst.type = LD_REG_REG;
-                            inst.arg1 = reg;
-                            inst.arg2 = addr_reg;
-                        }
-                    }
-                }
+            continue;
+        }
+        if (strcmp(argv[i], "--checkpoint-pc") == 0 && i + 1 < argc) {
+            checkpoint_pc = atoi(argv[++i]);
+            if (checkpoint_pc < 0) {
+                print_usage(argv[0]);
+                exit(1);
             }
+            continue;
+        }
+        if (strcmp(argv[i], "--lanes") == 0 && i + 1 < argc) {
+            lanes_path = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--sweep-hit") == 0 && i + 1 < argc) {
+            sweep_hit = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--sweep-miss") == 0 && i + 1 < argc) {
+            sweep_miss = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--sweep-size") == 0 && i + 1 < argc) {
+            sweep_size = argv[++i];
+            continue;
+        }
+#ifdef JIT_BACKEND
+        if (strcmp(argv[i], "--no-jit") == 0) {
+            options.jit = 0;
+            continue;
+        }
+#endif
+#ifdef ISS_PROFILE
+        if (strcmp(argv[i], "--profile") == 0) {
+            print_profile = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--profile-top") == 0 && i + 1 < argc) {
+            print_profile = 1;
+            profile_top = atoi(argv[++i]);
+            continue;
+        }
+#endif
+        if (strcmp(argv[i], "--no-fast-forward") == 0) {
+            options.fast_forward = 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--no-fusion") == 0) {
+            options.fusion = 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--fusion-stats") == 0) {
+            print_fusion_stats_flag = 1;
+            continue;
         }
+        if (strcmp(argv[i], "--cache-stats") == 0) {
+            print_cache_stats = 1;
+            options.cache_model = 1;
+            continue;
+        }
+        int parsed = cache_parse_option(&options.cache, argv[i], i + 1 < argc ? argv[i + 1] : NULL);
+        if (parsed <= 0) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        options.cache_model = 1;
+        i++;
     }
-    else if (strncmp(ptr, "ST", 2) == 0) {
-        ptr += 2;
-        while (*ptr == ' ') ptr++;
-        
-        char* bracket_start = strchr(ptr, '[');
-        if (bracket_start) {
-            bracket_start++;
-            while (*bracket_start == ' ') bracket_start++;
-            
-            int addr_reg = parse_register(bracket_start);
-            if (addr_reg >= 1 && addr_reg <= 6) {
-                char* bracket_end = strchr(bracket_start, ']');
-                if (bracket_end) {
-                    char* comma = strchr(bracket_end, ',');
-                    if (comma) {
-                        comma++;
-                        while (*comma == ' ') comma++;
-                        
-                        int reg = parse_register(comma);
-                        if (reg >= 1 && reg <= 6) {
-                            inst.type = ST_REG_REG;
-                            inst.arg1 = addr_reg;
-                            inst.arg2 = reg;
-                        }
-                    }
-                }
-            }
+    if (replay_path) {
+        if (filename || batch_path) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        IssContext* ctx = iss_create(&options);
+        if (!ctx) {
+            exit(1);
+        }
+        if (iss_replay_trace(ctx, replay_path) != 0) {
+            iss_destroy(ctx);
+            exit(1);
+        }
+        IssStats stats;
+        iss_get_stats(ctx, &stats);
+        print_results(stats.executed_instructions, stats.clock_cycles,
+                      stats.local_memory_hits, stats.memory_instructions);
+        if (stats.budget_exhausted) {
+            fprintf(stderr, "Warning: run budget reached, stopped before the program halted\n");
+        }
+        if (print_cache_stats) {
+            iss_print_cache_stats(ctx, stdout);
         }
+        iss_destroy(ctx);
+        return 0;
     }
-    
-    return inst;
-}
-
-// Get instructions from file
-Instruction* get_instructions_from_file(FILE* file, int* line_count, int* first_line) {
-    char buffer[MAX_LINE_LENGTH];
-    
-    // Read first line to get starting line number
-    if (fgets(buffer, sizeof(buffer), file)) {
-        sscanf(buffer, "%d ", first_line);
+    if (emit_path && (batch_path || lanes_path || sweep_hit || sweep_miss || sweep_size || trace_path)) {
+        fprintf(stderr, "Error: --emit-c translates a single program\n");
+        exit(1);
     }
-    rewind(file);
-    
-    // Count lines
-    *line_count = 0;
-    while (fgets(buffer, sizeof(buffer), file)) {
-        (*line_count)++;
+    if (trace_path && (batch_path || lanes_path || sweep_hit || sweep_miss || sweep_size)) {
+        fprintf(stderr, "Error: --trace records a single run\n");
+        exit(1);
     }
-    rewind(file);
-    
-    // Allocate instruction array
-    Instruction* insts = malloc((*line_count + *first_line) * sizeof(Instruction));
-    if (!insts) {
-        fprintf(stderr, "Memory allocation failed\n");
+    int checkpointing = checkpoint_at > 0 || checkpoint_every > 0 || checkpoint_pc >= 0;
+    if (checkpointing != (checkpoint_path != NULL)) {
+        fprintf(stderr, "Error: --checkpoint needs --checkpoint-at, --checkpoint-pc or --checkpoint-every\n");
         exit(1);
     }
-    
-    // Initialize all instructions to INVALID
-    for (int i = 0; i < *line_count + *first_line; i++) {
-        insts[i].type = INVALID;
-        insts[i].arg1 = 0;
-        insts[i].arg2 = 0;
+    if ((checkpoint_path || resume_path) &&
+        (batch_path || serve_path || lanes_path || sweep_hit || sweep_miss || sweep_size || trace_path ||
+         assemble_path || emit_path)) {
+        fprintf(stderr, "Error: checkpoints cover a single untraced run\n");
+        exit(1);
     }
-    
-    // Parse instructions
-    int idx = *first_line;
-    while (fgets(buffer, sizeof(buffer), file)) {
-        buffer[strcspn(buffer, "\n")] = '\0';
-        
-        // Skip empty lines, comments, and labels
-        int len = strlen(buffer);
-        if (len == 0 || buffer[0] == '#' || buffer[0] == ';') {
-            continue;
+    if (checkpoint_path || resume_path) {
+        // the generated code keeps no pc to stop at or resume from
+        options.jit = 0;
+    }
+    if (serve_path) {
+        // programs arrive on the socket, each with its own budget
+        if (filename || batch_path || lanes_path || sweep_hit || sweep_miss || sweep_size || trace_path ||
+            assemble_path || emit_path) {
+            print_usage(argv[0]);
+            exit(1);
         }
-        
-        // Skip lines ending with ':' (labels)
-        if (buffer[len-1] == ':') {
-            continue;
+        return run_server(serve_path, &options, batch_jobs) == 0 ? 0 : 1;
+    }
+    if (batch_path) {
+        if (filename) {
+            print_usage(argv[0]);
+            exit(1);
         }
-        
-        insts[idx] = parse_instruction_line(buffer);
-        idx++;
+        int result = run_batch(batch_path, &options, batch_jobs, batch_format);
+        return result < 0 ? 1 : result;
     }
-    
-    return insts;
-}
-
-// Execute instructions
-void execute_program() {
-    int executed_instructions = 0;
-    int clock_cycles = 0;
-    int local_memory_hits = 0;
-    int total_memory_hits = 0;
-    
-    // Initialize registers
-    for (int i = 1; i < 7; i++) {
-        cpu.registers[i] = 0;
+    if (!filename) {
+        print_usage(argv[0]);
+        exit(1);
     }
-    
-    // Execute instructions
-    for (int i = first_line_number; i < instruction_count + first_line_number; i++) {
-        executed_instructions++;
-        Instruction inst = instructions[i];
-        
-        int cycles = 1;
-        
-        switch (inst.type) {
-            case MOV_REG_IMM:
-                cpu.registers[inst.arg1] = inst.arg2;
-                cycles = 1;
-                break;
-                
-            case MOV_REG_REG:
-                cpu.registers[inst.arg1] = cpu.registers[inst.arg2];
-                cycles = 1;
-                break;
-                
-            case ADD_REG_REG:
-                cpu.registers[inst.arg1] += cpu.registers[inst.arg2];
-                cycles = 1;
-                break;
-                
-            case ADD_REG_IMM:
-                cpu.registers[inst.arg1] += inst.arg2;
-                cycles = 1;
-                break;
-                
-            case CMP_REG_REG:
-                cpu.zero_flag = (cpu.registers[inst.arg1] == cpu.registers[inst.arg2]);
-                cycles = 1;
-                break;
-                
-            case JE_ADDR:
-                if (cpu.zero_flag) {
-                    int target = inst.arg1;
-                    i = target - 1; // -1 because loop will increment
-                }
-                cycles = 1;
-                break;
-                
-            case JMP_ADDR:
-                {
-                    int target = inst.arg1;
-                    i = target - 1; // -1 because loop will increment
-                }
-                cycles = 1;
-                break;
-                
-            case LD_REG_REG:
-                {
-                    uint8_t addr = (uint8_t)cpu.registers[inst.arg2];
-                    if (!memory.touched[addr]) {
-                        memory.touched[addr] = 1;
-                        cycles = CACHE_MISS_CYCLES + 1;
-                    } else {
-                        local_memory_hits++;
-                        cycles = CACHE_HIT_CYCLES + 1;
-                    }
-                    cpu.registers[inst.arg1] = memory.memory[addr];
-                    total_memory_hits++;
-                }
-                break;
-                
-            case LD_REV_REG_REG:
-                {
-                    uint8_t addr = (uint8_t)cpu.registers[inst.arg1];
-                    if (!memory.touched[addr]) {
-                        memory.touched[addr] = 1;
-                        cycles = CACHE_MISS_CYCLES + 1;
-                    } else {
-                        local_memory_hits++;
-                        cycles = CACHE_HIT_CYCLES + 1;
-                    }
-                    cpu.registers[inst.arg2] = memory.memory[addr];
-                    total_memory_hits++;
-                }
-                break;
-                
-            case ST_REG_REG:
-                {
-                    uint8_t addr = (uint8_t)cpu.registers[inst.arg1];
-                    if (!memory.touched[addr]) {
-                        memory.touched[addr] = 1;
-                        cycles = CACHE_MISS_CYCLES + 1;
-                    } else {
-                        local_memory_hits++;
-                        cycles = CACHE_HIT_CYCLES + 1;
-                    }
-                    memory.memory[addr] = (uint8_t)cpu.registers[inst.arg2];
-                    total_memory_hits++;
-                }
-                break;
-                
-            case INVALID:
-                // Skip invalid instructions
-                cycles = 0;
-                break;
-        }
-        
-        clock_cycles += cycles;
+    if (lanes_path) {
+        int result = run_lanes(filename, &options, lanes_path, batch_format);
+        return result < 0 ? 1 : result;
+    }
+    if (sweep_hit || sweep_miss || sweep_size) {
+        SweepConfig sweep;
+        sweep_config_default(&sweep, &options);
+        if ((sweep_hit && sweep_parse_range(&sweep.hit_cycles, sweep_hit) != 0) ||
+            (sweep_miss && sweep_parse_range(&sweep.miss_cycles, sweep_miss) != 0) ||
+            (sweep_size && sweep_parse_range(&sweep.memory_size, sweep_size) != 0)) {
+            fprintf(stderr, "Error: ranges are A, A:B or A:B:S with 0 <= A <= B\n");
+            exit(1);
+        }
+        // sizes double from the first, so it fixes every size of the sweep
+        int size_first = sweep.memory_size.first;
+        if (sweep_size && (size_first == 0 || (size_first & (size_first - 1)) != 0 ||
+                           strchr(sweep_size, ':') != strrchr(sweep_size, ':'))) {
+            fprintf(stderr, "Error: --sweep-size is A or A:B with A a power of two, sizes double from A up to B\n");
+            exit(1);
+        }
+        sweep.sweep_memory_size = sweep_size != NULL;
+        SweepFormat sweep_format = !format_given ? SWEEP_FORMAT_TABLE :
+            batch_format == BATCH_FORMAT_JSON ? SWEEP_FORMAT_JSON : SWEEP_FORMAT_CSV;
+        int result = run_sweep(filename, &options, &sweep, batch_jobs, sweep_format);
+        return result < 0 ? 1 : result;
     }
     
-    // Print results
-    printf("Total number of executed instructions: %d\n", executed_instructions);
-    printf("Total number of clock cycles: %d\n", clock_cycles);
-    printf("Number of hits to local memory: %d\n", local_memory_hits);
-    printf("Total number of executed LD/ST instructions: %d\n", total_memory_hits);
-}
-
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <assembly_file>\n", argv[0]);
+    IssContext* ctx = iss_create(&options);
+    if (!ctx) {
         exit(1);
     }
-    
-    FILE* file = fopen(argv[1], "r");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file %s\n", argv[1]);
+    if (iss_load_file(ctx, filename) != 0) {
+        iss_destroy(ctx);
         exit(1);
     }
+    if (assemble_path) {
+        int result = iss_save_binary(ctx, assemble_path);
+        iss_destroy(ctx);
+        return result == 0 ? 0 : 1;
+    }
+    if (emit_path) {
+        int result = iss_emit_c(ctx, emit_path);
+        iss_destroy(ctx);
+        return result == 0 ? 0 : 1;
+    }
     
-    instructions = get_instructions_from_file(file, &instruction_count, &first_line_number);
-    fclose(file);
-    
-    execute_program();
+    if (trace_path && iss_trace_open(ctx, trace_path) != 0) {
+        iss_destroy(ctx);
+        exit(1);
+    }
+    if (checkpoint_path) {
+        if (resume_path && iss_load_checkpoint(ctx, resume_path) != 0) {
+            iss_destroy(ctx);
+            exit(1);
+        }
+        int written = run_checkpointed(ctx, &options, checkpoint_path, checkpoint_at, checkpoint_pc,
+                                       checkpoint_every);
+        if (written < 0) {
+            iss_destroy(ctx);
+            exit(1);
+        }
+        if (written == 0) {
+            fprintf(stderr, "Warning: the run ended before its checkpoint, %s not written\n", checkpoint_path);
+        }
+    } else if (resume_path) {
+        if (iss_load_checkpoint(ctx, resume_path) != 0 || iss_resume(ctx) != 0) {
+            iss_destroy(ctx);
+            exit(1);
+        }
+    } else {
+        iss_run(ctx);
+    }
+    if (trace_path && iss_trace_close(ctx) != 0) {
+        fprintf(stderr, "Error: Cannot write trace file %s\n", trace_path);
+        iss_destroy(ctx);
+        exit(1);
+    }
+    IssStats stats;
+    iss_get_stats(ctx, &stats);
+    print_results(stats.executed_instructions, stats.clock_cycles,
+                  stats.local_memory_hits, stats.memory_instructions);
+    if (stats.budget_exhausted) {
+        fprintf(stderr, "Warning: run budget reached, stopped before the program halted\n");
+    }
+    if (print_cache_stats) {
+        iss_print_cache_stats(ctx, stdout);
+    }
+    if (print_fusion_stats_flag) {
+        iss_print_fusion_stats(ctx, stdout);
+    }
+#ifdef ISS_PROFILE
+    if (print_profile) {
+        iss_print_profile(ctx, stdout, profile_top);
+    }
+#endif
     
-    free(instructions);
+    iss_destroy(ctx);
     return 0;
 }
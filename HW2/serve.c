@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "serve.h"
+
+// Pre-threaded: every worker blocks in accept on the shared listening
+// socket and serves the connection it gets until the client closes it, so
+// no queue or lock sits between a request and its worker. A worker keeps
+// its context and receive buffer from request to request.
+typedef struct {
+    int listen_fd;
+    const IssOptions* options;
+} Server;
+
+typedef struct {
+    Server* server;
+    IssContext* ctx;
+    char* buffer;
+    size_t capacity;
+} Worker;
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t* p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    for (int b = 0; b < 4; b++) {
+        p[b] = (uint8_t)(value >> (8 * b));
+    }
+}
+
+static void put_u64(uint8_t* p, uint64_t value) {
+    put_u32(p, (uint32_t)value);
+    put_u32(p + 4, (uint32_t)(value >> 32));
+}
+
+// returns 0 once size bytes arrived, -1 on end of stream or error
+static int receive_all(int fd, void* data, size_t size) {
+    char* pos = data;
+    while (size > 0) {
+        ssize_t got = recv(fd, pos, size, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        pos += got;
+        size -= (size_t)got;
+    }
+    return 0;
+}
+
+// MSG_NOSIGNAL: a client that went away is an error here, not a SIGPIPE
+static int send_all(int fd, const void* data, size_t size) {
+    const char* pos = data;
+    while (size > 0) {
+        ssize_t sent = send(fd, pos, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        pos += sent;
+        size -= (size_t)sent;
+    }
+    return 0;
+}
+
+// the request's budget, 0 or above the server's own falls back to the server's
+static long long effective_budget(uint64_t requested, long long server) {
+    if (requested == 0 || requested > (uint64_t)INT64_MAX || (server > 0 && (long long)requested > server)) {
+        return server;
+    }
+    return (long long)requested;
+}
+
+static int reply(int fd, uint32_t flags, int status, const IssStats* stats) {
+    if (flags & SERVE_FLAG_JSON) {
+        static const char* const names[] = {"ok", "budget", "error"};
+        char line[256];
+        int length = snprintf(line, sizeof(line),
+                              "{\"executed_instructions\":%lld,\"clock_cycles\":%lld,\"local_memory_hits\":%lld,"
+                              "\"ld_st_instructions\":%lld,\"status\":\"%s\"}\n",
+                              stats->executed_instructions, stats->clock_cycles, stats->local_memory_hits,
+                              stats->memory_instructions, names[status]);
+        return send_all(fd, line, (size_t)length);
+    }
+    uint8_t packet[SERVE_REPLY_SIZE];
+    put_u32(packet, (uint32_t)status);
+    put_u64(packet + 4, (uint64_t)stats->executed_instructions);
+    put_u64(packet + 12, (uint64_t)stats->clock_cycles);
+    put_u64(packet + 20, (uint64_t)stats->local_memory_hits);
+    put_u64(packet + 28, (uint64_t)stats->memory_instructions);
+    return send_all(fd, packet, sizeof(packet));
+}
+
+// one request, returns -1 when the connection is done
+static int serve_request(Worker* worker, int fd) {
+    uint8_t header[SERVE_HEADER_SIZE];
+    if (receive_all(fd, header, sizeof(header)) != 0) {
+        return -1;
+    }
+    uint32_t size = get_u32(header);
+    uint32_t flags = get_u32(header + 4);
+    if (size > SERVE_MAX_PROGRAM || (flags & ~SERVE_FLAG_JSON)) {
+        return -1;
+    }
+    if (size > worker->capacity) {
+        char* grown = realloc(worker->buffer, size);
+        if (!grown) {
+            return -1;
+        }
+        worker->buffer = grown;
+        worker->capacity = size;
+    }
+    if (receive_all(fd, worker->buffer, size) != 0) {
+        return -1;
+    }
+
+    // budget first: a JIT context compiles it into the code of the load
+    const IssOptions* options = worker->server->options;
+    iss_set_budget(worker->ctx, effective_budget(get_u64(header + 8), options->max_instructions),
+                   effective_budget(get_u64(header + 16), options->max_cycles), -1);
+    IssStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int status = SERVE_STATUS_ERROR;
+    if (iss_load_memory(worker->ctx, worker->buffer, size) == 0) {
+        iss_run(worker->ctx);
+        iss_get_stats(worker->ctx, &stats);
+        status = stats.budget_exhausted ? SERVE_STATUS_BUDGET : SERVE_STATUS_HALTED;
+    }
+    return reply(fd, flags, status, &stats);
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    for (;;) {
+        int fd = accept(worker->server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            return NULL;
+        }
+        while (serve_request(worker, fd) == 0) {
+        }
+        close(fd);
+    }
+}
+
+// bind, replacing a socket file nobody listens on any more
+static int open_socket(const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: socket path %s is too long\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct stat info;
+    if (stat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+            fprintf(stderr, "Error: a server is already listening on %s\n", socket_path);
+            close(fd);
+            return -1;
+        }
+        unlink(socket_path);
+    }
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_server(const char* socket_path, const IssOptions* options, int jobs) {
+    if (jobs <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cores > 0 ? (int)cores : 1;
+    }
+
+    // the workers inherit the mask, only sigwait below sees the signals
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    // static: detached workers still use it while the process exits
+    static Server server;
+    server.options = options;
+    server.listen_fd = open_socket(socket_path);
+    if (server.listen_fd < 0) {
+        return -1;
+    }
+
+    Worker* workers = calloc((size_t)jobs, sizeof(Worker));
+    if (!workers) {
+        fprintf(stderr, "Memory allocation failed\n");
+        close(server.listen_fd);
+        unlink(socket_path);
+        return -1;
+    }
+    int started = 0;
+    for (int w = 0; w < jobs; w++) {
+        workers[w].server = &server;
+        workers[w].ctx = iss_create(options);
+        pthread_t thread;
+        if (!workers[w].ctx || pthread_create(&thread, NULL, worker_main, &workers[w]) != 0) {
+            iss_destroy(workers[w].ctx);
+            break;
+        }
+        pthread_detach(thread);
+        started++;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Error: Cannot start the server workers\n");
+        free(workers);
+        close(server.listen_fd);
+        unlink(socket_path);
+        return -1;
+    }
+    fprintf(stderr, "Serving on %s with %d workers\n", socket_path, started);
+    if (options->max_instructions <= 0 && options->max_cycles <= 0) {
+        fprintf(stderr, "Warning: no server budget, a request that never halts holds its worker\n");
+    }
+
+    // workers may be mid-request or in accept, the process exit ends them
+    int received;
+    sigwait(&signals, &received);
+    unlink(socket_path);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "iss.h"
+
+// Server mode: stay resident on a Unix domain socket and simulate the
+// programs sent to it, so a driver pays a round trip per program instead of
+// a process start. A pool of worker threads, one IssContext each, takes
+// connections in turn, and a connection may send any number of requests,
+// answered in order. Every field is little endian.
+//
+//   request  u32 program size, u32 flags, u64 max instructions,
+//            u64 max cycles (24 bytes), then the program: assembly text or
+//            an .issbin image
+//   flags    bit 0: reply in JSON instead of binary
+//   budget   0 takes the server's --max-instructions / --max-cycles, which
+//            also cap any larger request
+//   binary   u32 status, then executed instructions, clock cycles, local
+//            memory hits and LD/ST instructions as u64 (36 bytes)
+//   json     one line: the four counters and "status", then '\n'
+//   status   0 halted, 1 stopped by the budget, 2 program failed to load
+//
+// A malformed header or a program over SERVE_MAX_PROGRAM closes the
+// connection. .issbin images are validated like files before they run.
+//
+// Without a server --max-instructions or --max-cycles the budget is only
+// what each request asks for, and a request with none that never halts
+// holds its worker forever: jobs of them stall the whole server. Start it
+// with a budget when clients are not trusted to send one.
+
+#define SERVE_HEADER_SIZE 24
+#define SERVE_REPLY_SIZE 36
+#define SERVE_FLAG_JSON 1u
+#define SERVE_MAX_PROGRAM (64u << 20)
+
+enum {
+    SERVE_STATUS_HALTED = 0,
+    SERVE_STATUS_BUDGET,
+    SERVE_STATUS_ERROR
+};
+
+// listen on socket_path until SIGINT or SIGTERM, then remove it. jobs <= 0
+// means one worker per core.
+// returns 0 after a signal, -1 if the socket could not be set up
+int run_server(const char* socket_path, const IssOptions* options, int jobs);
+
+#endif
@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source.h"
+
+int source_open(SourceText* text, const char* filename) {
+    memset(text, 0, sizeof(*text));
+
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // one front-to-back pass, let the kernel read ahead
+            posix_madvise(data, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+            close(fd);
+            text->data = data;
+            text->size = (size_t)info.st_size;
+            text->mapped = 1;
+            return 0;
+        }
+    }
+
+    // empty files, pipes and anything mmap refuses are read instead
+    FILE* file = fdopen(fd, "r");
+    if (!file) {
+        close(fd);
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return -1;
+    }
+    int result = source_read_stream(text, file);
+    fclose(file);
+    return result;
+}
+
+int source_read_stream(SourceText* text, FILE* file) {
+    memset(text, 0, sizeof(*text));
+
+    size_t capacity = 0;
+    size_t size = 0;
+    char* buffer = NULL;
+    for (;;) {
+        if (size == capacity) {
+            size_t grown = capacity ? capacity * 2 : 65536;
+            char* resized = realloc(buffer, grown);
+            if (!resized) {
+                free(buffer);
+                fprintf(stderr, "Memory allocation failed\n");
+                return -1;
+            }
+            buffer = resized;
+            capacity = grown;
+        }
+        size_t read = fread(buffer + size, 1, capacity - size, file);
+        if (read == 0) {
+            break;
+        }
+        size += read;
+    }
+    if (ferror(file)) {
+        free(buffer);
+        fprintf(stderr, "Error: Could not read program text\n");
+        return -1;
+    }
+    text->data = buffer;
+    text->size = size;
+    text->buffer = buffer;
+    return 0;
+}
+
+void source_close(SourceText* text) {
+    if (text->mapped) {
+        munmap((void*)text->data, text->size);
+    }
+    free(text->buffer);
+    memset(text, 0, sizeof(*text));
+}
+
+size_t source_count_lines(const SourceText* text) {
+    if (text->size == 0) {
+        return 0;
+    }
+    size_t lines = 0;
+    const char* end = text->data + text->size;
+    for (const char* ptr = text->data; (ptr = memchr(ptr, '\n', (size_t)(end - ptr))) != NULL; ptr++) {
+        lines++;
+    }
+    return lines + (end[-1] != '\n');
+}
+
+const char* source_next_line(const SourceText* text, const char** cursor, const char** line_end) {
+    const char* end = text->data + text->size;
+    const char* line = *cursor;
+    if (!line || line >= end) {
+        return NULL;
+    }
+    const char* newline = memchr(line, '\n', (size_t)(end - line));
+    *line_end = newline ? newline : end;
+    *cursor = newline ? newline + 1 : end;
+    return line;
+}
+
+const char* span_find(const char* ptr, const char* end, char c) {
+    return ptr < end ? memchr(ptr, c, (size_t)(end - ptr)) : NULL;
+}
+
+int span_starts_with(const char* ptr, const char* end, const char* prefix) {
+    size_t length = strlen(prefix);
+    return (size_t)(end - ptr) >= length && memcmp(ptr, prefix, length) == 0;
+}
+
+int span_atoi(const char* ptr, const char* end) {
+    while (ptr < end && (*ptr == ' ' || (*ptr >= '\t' && *ptr <= '\r'))) {
+        ptr++;
+    }
+    int negative = 0;
+    if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+        negative = (*ptr == '-');
+        ptr++;
+    }
+    // accumulate like strtol, saturating at the long range, then narrow
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    unsigned long value = 0;
+    for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++) {
+        unsigned long digit = (unsigned long)(*ptr - '0');
+        if (value > (limit - digit) / 10) {
+            value = limit;
+        } else {
+            value = value * 10 + digit;
+        }
+    }
+    long result = negative ? (long)(0 - value) : (long)value;
+    return (int)result;
+}
@@ -0,0 +1,40 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Program text loader shared by both simulators. A regular file is mapped
+// read-only and lexed in place, so loading copies no lines and has no limit
+// on line length or line count. Lines are spans [line, line_end) that stop
+// before the '\n'; nothing is NUL-terminated, so lexers use the span_*
+// helpers below instead of the string functions.
+
+typedef struct {
+    const char* data;
+    size_t size;
+    void* buffer;   // heap copy when the text could not be mapped
+    int mapped;
+} SourceText;
+
+// returns 0 on success, -1 on failure (message on stderr)
+int source_open(SourceText* text, const char* filename);
+// read a whole stream (pipes, stdin) into memory
+int source_read_stream(SourceText* text, FILE* file);
+void source_close(SourceText* text);
+
+// number of lines, a last line without '\n' counts too
+size_t source_count_lines(const SourceText* text);
+
+// the line at *cursor (start at text->data), *cursor moves past its '\n'
+// returns NULL at the end of the text
+const char* source_next_line(const SourceText* text, const char** cursor, const char** line_end);
+
+// bounded strchr: first c in [ptr, end), NULL if there is none
+const char* span_find(const char* ptr, const char* end, char c);
+// bounded strncmp(ptr, prefix, strlen(prefix)) == 0
+int span_starts_with(const char* ptr, const char* end, const char* prefix);
+// bounded atoi, same whitespace, sign and overflow behaviour
+int span_atoi(const char* ptr, const char* end);
+
+#endif
@@ -0,0 +1,226 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "sweep.h"
+
+// Cycles are linear in the access outcomes: every instruction costs one
+// cycle and an LD/ST adds the hit or miss latency on top. A run's hit and
+// miss counts are therefore all we need to cost it under any latencies,
+// only the memory size changes which accesses hit and needs its own run.
+typedef struct {
+    uint32_t memory_size;
+    IssStats stats;
+    int ok;
+} SizeRun;
+
+typedef struct {
+    const IssContext* source;
+    const IssOptions* options;
+    const SweepConfig* config;
+    SizeRun* runs;
+    int count;
+    atomic_int next;
+} Sweep;
+
+int sweep_parse_range(SweepRange* range, const char* text) {
+    char* end = NULL;
+    long values[3] = {0, 0, 1};
+    int parts = 0;
+
+    while (parts < 3) {
+        values[parts++] = strtol(text, &end, 10);
+        if (end == text || values[parts - 1] < 0 || values[parts - 1] > 1000000) {
+            return -1;
+        }
+        if (*end != ':') {
+            break;
+        }
+        text = end + 1;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+    if (parts == 1) {
+        values[1] = values[0];
+    }
+    if (values[1] < values[0] || values[2] <= 0) {
+        return -1;
+    }
+    range->first = (int)values[0];
+    range->last = (int)values[1];
+    range->step = (int)values[2];
+    return 0;
+}
+
+void sweep_config_default(SweepConfig* config, const IssOptions* options) {
+    config->hit_cycles.first = config->hit_cycles.last = options->hit_cycles;
+    config->hit_cycles.step = 1;
+    config->miss_cycles.first = config->miss_cycles.last = options->miss_cycles;
+    config->miss_cycles.step = 1;
+    config->memory_size.first = config->memory_size.last = (int)options->cache.size;
+    config->memory_size.step = 1;
+    config->sweep_memory_size = 0;
+}
+
+static void* sweep_worker(void* arg) {
+    Sweep* sweep = arg;
+    IssContext* ctx = NULL;
+    uint32_t ctx_size = 0;
+
+    for (;;) {
+        int job = atomic_fetch_add(&sweep->next, 1);
+        if (job >= sweep->count) {
+            break;
+        }
+        SizeRun* run = &sweep->runs[job];
+        IssOptions options = *sweep->options;
+        if (sweep->config->sweep_memory_size) {
+            options.cache_model = 1;
+            options.cache.size = run->memory_size;
+        }
+        // the geometry is fixed when a context is created
+        if (!ctx || ctx_size != run->memory_size) {
+            iss_destroy(ctx);
+            ctx = iss_create(&options);
+            ctx_size = run->memory_size;
+        }
+        if (!ctx || iss_load_copy(ctx, sweep->source) != 0) {
+            continue;
+        }
+        iss_run(ctx);
+        iss_get_stats(ctx, &run->stats);
+        run->ok = 1;
+    }
+
+    iss_destroy(ctx);
+    return NULL;
+}
+
+static void print_point(SweepFormat format, const SizeRun* run, int hit_cycles, int miss_cycles,
+                        long long clock_cycles) {
+    const IssStats* stats = &run->stats;
+    if (format == SWEEP_FORMAT_JSON) {
+        printf("{\"memory_size\":%u,\"hit_cycles\":%d,\"miss_cycles\":%d,\"executed_instructions\":%lld,"
+               "\"clock_cycles\":%lld,\"local_memory_hits\":%lld,\"ld_st_instructions\":%lld}\n",
+               run->memory_size, hit_cycles, miss_cycles, stats->executed_instructions,
+               clock_cycles, stats->local_memory_hits, stats->memory_instructions);
+    } else if (format == SWEEP_FORMAT_CSV) {
+        printf("%u,%d,%d,%lld,%lld,%lld,%lld\n",
+               run->memory_size, hit_cycles, miss_cycles, stats->executed_instructions,
+               clock_cycles, stats->local_memory_hits, stats->memory_instructions);
+    } else {
+        printf("%11u %10d %11d %14lld %14lld %12lld %10lld\n",
+               run->memory_size, hit_cycles, miss_cycles, stats->executed_instructions,
+               clock_cycles, stats->local_memory_hits, stats->memory_instructions);
+    }
+}
+
+int run_sweep(const char* filename, const IssOptions* options, const SweepConfig* config,
+              int jobs, SweepFormat format) {
+    // where a cycle budget stops depends on the latencies, which are only
+    // applied after the run
+    if (options->max_cycles > 0 &&
+        (config->hit_cycles.first != options->hit_cycles || config->hit_cycles.last != options->hit_cycles ||
+         config->miss_cycles.first != options->miss_cycles || config->miss_cycles.last != options->miss_cycles)) {
+        fprintf(stderr, "Error: --max-cycles cannot be combined with a latency sweep\n");
+        return -1;
+    }
+    // decode once, every worker copies the decoded program
+    IssContext* source = iss_create(options);
+    if (!source) {
+        return -1;
+    }
+    if (iss_load_file(source, filename) != 0) {
+        iss_destroy(source);
+        return -1;
+    }
+
+    Sweep sweep;
+    memset(&sweep, 0, sizeof(sweep));
+    sweep.source = source;
+    sweep.options = options;
+    sweep.config = config;
+    if (config->sweep_memory_size) {
+        for (long size = config->memory_size.first; size <= config->memory_size.last; size *= 2) {
+            sweep.count++;
+        }
+    } else {
+        sweep.count = 1;
+    }
+    sweep.runs = calloc((size_t)sweep.count, sizeof(SizeRun));
+    if (!sweep.runs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int r = 0; r < sweep.count; r++) {
+        sweep.runs[r].memory_size = config->sweep_memory_size ?
+            (uint32_t)config->memory_size.first << r : options->cache.size;
+    }
+    atomic_init(&sweep.next, 0);
+
+    if (jobs <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cores > 0 ? (int)cores : 1;
+    }
+    if (jobs > sweep.count) {
+        jobs = sweep.count;
+    }
+    pthread_t* threads = malloc((size_t)jobs * sizeof(pthread_t));
+    if (!threads) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    int started = 0;
+    for (int w = 0; w < jobs; w++) {
+        if (pthread_create(&threads[w], NULL, sweep_worker, &sweep) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        sweep_worker(&sweep);
+    }
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    if (format == SWEEP_FORMAT_CSV) {
+        printf("memory_size,hit_cycles,miss_cycles,executed_instructions,clock_cycles,"
+               "local_memory_hits,ld_st_instructions\n");
+    } else if (format == SWEEP_FORMAT_TABLE) {
+        printf("%11s %10s %11s %14s %14s %12s %10s\n", "memory_size", "hit_cycles", "miss_cycles",
+               "instructions", "clock_cycles", "memory_hits", "ld_st");
+    }
+    int failures = 0;
+    for (int r = 0; r < sweep.count; r++) {
+        const SizeRun* run = &sweep.runs[r];
+        if (!run->ok) {
+            fprintf(stderr, "Error: memory size %u could not be simulated\n", run->memory_size);
+            failures++;
+            continue;
+        }
+        if (run->stats.budget_exhausted) {
+            fprintf(stderr, "Warning: memory size %u stopped at the run budget\n", run->memory_size);
+        }
+        // strip the latencies the functional run was costed with
+        long long hits = run->stats.local_memory_hits;
+        long long misses = run->stats.memory_instructions - hits;
+        long long base = run->stats.clock_cycles - hits * options->hit_cycles - misses * options->miss_cycles;
+        for (int hit = config->hit_cycles.first; hit <= config->hit_cycles.last; hit += config->hit_cycles.step) {
+            for (int miss = config->miss_cycles.first; miss <= config->miss_cycles.last; miss += config->miss_cycles.step) {
+                print_point(format, run, hit, miss, base + hits * hit + misses * miss);
+            }
+        }
+    }
+
+    free(threads);
+    free(sweep.runs);
+    iss_destroy(source);
+    return failures ? 1 : 0;
+}
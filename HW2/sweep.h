@@ -0,0 +1,42 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "iss.h"
+
+// Sweep mode: simulate one program under every combination of LD/ST hit
+// latency, miss latency and local memory size. The program is decoded once,
+// each memory size gets one functional run (in parallel), and every latency
+// pair is then costed from that run's hit and miss counts.
+
+typedef struct {
+    int first;
+    int last;
+    int step;   // sizes double instead, main rejects a step for them
+} SweepRange;
+
+typedef struct {
+    SweepRange hit_cycles;
+    SweepRange miss_cycles;
+    SweepRange memory_size;
+    int sweep_memory_size;  // 0: keep the memory model of the options
+} SweepConfig;
+
+typedef enum {
+    SWEEP_FORMAT_TABLE = 0,
+    SWEEP_FORMAT_CSV,
+    SWEEP_FORMAT_JSON       // JSON lines, one object per configuration
+} SweepFormat;
+
+// parse "A", "A:B" or "A:B:S" into range, returns 0 or -1 on a bad range
+int sweep_parse_range(SweepRange* range, const char* text);
+
+// fill in single-point ranges at the latencies of options
+void sweep_config_default(SweepConfig* config, const IssOptions* options);
+
+// jobs <= 0 means one worker per core
+// returns 0 on success, 1 if some configuration could not run, -1 if the
+// program could not be loaded
+int run_sweep(const char* filename, const IssOptions* options, const SweepConfig* config,
+              int jobs, SweepFormat format);
+
+#endif
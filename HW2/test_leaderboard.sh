@@ -12,7 +12,7 @@ for test_file in "${TEST_FILES[@]}"; do
         echo "========================================"
         
         # Test each version multiple times for accuracy
-        versions=("myISS" "myISS_optimized" "myISS_final")
+        versions=("myISS" "myISS_threaded" "myISS_optimized" "myISS_final")
         
         for version in "${versions[@]}"; do
             if [ -f "$version" ]; then
@@ -5,6 +5,11 @@
 echo "=== myISS Performance Testing ==="
 echo
 
+if [ ! -x ./issbench ]; then
+    echo "issbench not found, build it with: make bench"
+    exit 1
+fi
+
 # Test files
 TEST_FILES=("sample.assembly" "large_test.assembly")
 
@@ -18,20 +23,9 @@ for test_file in "${TEST_FILES[@]}"; do
         ./myISS "$test_file"
         echo
         
-        # Time multiple runs
-        echo "Timing 10 runs:"
-        total_time=0
-        for i in {1..10}; do
-            start_time=$(date +%s.%N)
-            ./myISS "$test_file" > /dev/null 2>&1
-            end_time=$(date +%s.%N)
-            runtime=$(echo "$end_time - $start_time" | bc -l)
-            total_time=$(echo "$total_time + $runtime" | bc -l)
-            printf "Run %2d: %.6f seconds\n" $i $runtime
-        done
-        
-        avg_time=$(echo "scale=6; $total_time / 10" | bc -l)
-        echo "Average runtime: $avg_time seconds"
+        # Time the phases in-process, whole-process timings mostly measure fork/exec
+        echo "Phase timings (issbench, per run):"
+        ./issbench "$test_file"
         echo
     else
         echo "Test file $test_file not found!"
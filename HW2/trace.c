@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "trace.h"
+#include "source.h"
+
+// the writer thread flushes whichever buffer is pending, the engine never
+// hands over a buffer before the other one is written, so order is kept
+static void* trace_writer_thread(void* arg) {
+    TraceWriter* w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        int b = w->pending[0] ? 0 : (w->pending[1] ? 1 : -1);
+        if (b < 0) {
+            if (w->stop) {
+                break;
+            }
+            pthread_cond_wait(&w->cond, &w->lock);
+            continue;
+        }
+        size_t size = w->pending[b];
+        pthread_mutex_unlock(&w->lock);
+        int failed = fwrite(w->buffers[b], 1, size, w->file) != size;
+        pthread_mutex_lock(&w->lock);
+        w->error |= failed;
+        w->pending[b] = 0;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static void trace_writer_free(TraceWriter* w) {
+    free(w->buffers[0]);
+    free(w->buffers[1]);
+    free(w->defined);
+    free(w);
+}
+
+TraceWriter* trace_writer_open(const char* filename, int records) {
+    TraceWriter* w = calloc(1, sizeof(TraceWriter));
+    if (!w) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+    w->buffers[0] = malloc(TRACE_BUFFER_SIZE);
+    w->buffers[1] = malloc(TRACE_BUFFER_SIZE);
+    w->defined = calloc((size_t)records + 1, 1);
+    if (!w->buffers[0] || !w->buffers[1] || !w->defined) {
+        fprintf(stderr, "Memory allocation failed\n");
+        trace_writer_free(w);
+        return NULL;
+    }
+    w->file = fopen(filename, "wb");
+    if (!w->file) {
+        fprintf(stderr, "Error: Cannot create trace file %s\n", filename);
+        trace_writer_free(w);
+        return NULL;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE] = {0};
+    memcpy(header, TRACE_MAGIC, 8);
+    header[8] = TRACE_VERSION;
+    if (fwrite(header, 1, sizeof(header), w->file) != sizeof(header)) {
+        fprintf(stderr, "Error: Cannot write trace file %s\n", filename);
+        fclose(w->file);
+        trace_writer_free(w);
+        return NULL;
+    }
+
+    w->active = 0;
+    w->pos = w->buffers[0];
+    w->limit = w->buffers[0] + TRACE_BUFFER_SIZE - TRACE_MAX_RECORD;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, trace_writer_thread, w) != 0) {
+        fprintf(stderr, "Error: Cannot start the trace writer thread\n");
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        fclose(w->file);
+        trace_writer_free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void trace_writer_swap(TraceWriter* w) {
+    size_t size = (size_t)(w->pos - w->buffers[w->active]);
+    int next = 1 - w->active;
+    pthread_mutex_lock(&w->lock);
+    while (w->pending[next]) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    if (size > 0) {
+        w->pending[w->active] = size;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    w->active = next;
+    w->pos = w->buffers[next];
+    w->limit = w->buffers[next] + TRACE_BUFFER_SIZE - TRACE_MAX_RECORD;
+}
+
+void trace_end_run(TraceWriter* w, long long instructions, long long cycles, long long hits,
+                   long long memory_ops, int budget_exhausted) {
+    if (w->pos > w->limit) {
+        trace_writer_swap(w);
+    }
+    trace_put(w, 0);
+    trace_put(w, (uint64_t)instructions);
+    trace_put(w, (uint64_t)cycles);
+    trace_put(w, (uint64_t)hits);
+    trace_put(w, (uint64_t)memory_ops);
+    trace_put(w, (uint64_t)budget_exhausted);
+    // the next run starts from scratch, definitions stay valid
+    w->previous_end = 0;
+    w->previous_addr = 0;
+}
+
+int trace_writer_close(TraceWriter* w) {
+    if (!w) {
+        return 0;
+    }
+    trace_writer_swap(w);
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+
+    int result = w->error ? -1 : 0;
+    if (fclose(w->file) != 0) {
+        result = -1;
+    }
+    trace_writer_free(w);
+    return result;
+}
+
+// returns 0 on success, -1 at the end of the data or on an overlong varint
+static int trace_get(TraceReader* r, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && r->pos < r->end; shift += 7) {
+        uint8_t byte = *r->pos++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    r->corrupt = 1;
+    return -1;
+}
+
+static int64_t trace_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// make room for pc in the definition table
+static int trace_grow_blocks(TraceReader* r, int64_t pc) {
+    if (pc < 0 || pc >= INT32_MAX) {
+        return -1;
+    }
+    if ((size_t)pc < r->capacity) {
+        return 0;
+    }
+    size_t grown = r->capacity ? r->capacity : 1024;
+    while (grown <= (size_t)pc) {
+        grown *= 2;
+    }
+    TraceBlock* resized = realloc(r->blocks, grown * sizeof(TraceBlock));
+    if (!resized) {
+        return -1;
+    }
+    memset(resized + r->capacity, 0, (grown - r->capacity) * sizeof(TraceBlock));
+    r->blocks = resized;
+    r->capacity = grown;
+    return 0;
+}
+
+int trace_reader_open(TraceReader* r, const char* filename) {
+    memset(r, 0, sizeof(*r));
+    if (source_open(&r->text, filename) != 0) {
+        return -1;
+    }
+    r->pos = (const uint8_t*)r->text.data;
+    r->end = r->pos + r->text.size;
+    if (r->text.size < TRACE_HEADER_SIZE || memcmp(r->pos, TRACE_MAGIC, 8) != 0 || r->pos[8] != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s is not a version %d trace\n", filename, TRACE_VERSION);
+        source_close(&r->text);
+        return -1;
+    }
+    r->pos += TRACE_HEADER_SIZE;
+    return 0;
+}
+
+void trace_reader_close(TraceReader* r) {
+    free(r->blocks);
+    r->blocks = NULL;
+    source_close(&r->text);
+}
+
+int trace_reader_next_block(TraceReader* r, const TraceBlock** block, int* budget_exhausted) {
+    uint64_t value;
+    if (trace_get(r, &value) != 0) {
+        return -1;
+    }
+    if (value == 0) {
+        // footer: the counters as recorded, only the budget stop is kept
+        uint64_t footer[5];
+        for (int f = 0; f < 5; f++) {
+            if (trace_get(r, &footer[f]) != 0) {
+                return -1;
+            }
+        }
+        *budget_exhausted = footer[4] != 0;
+        r->previous_end = 0;
+        r->previous_addr = 0;
+        return 0;
+    }
+    int64_t pc = r->previous_end + trace_unzigzag(value - 1);
+    if (trace_grow_blocks(r, pc) != 0) {
+        r->corrupt = 1;
+        return -1;
+    }
+    TraceBlock* entry = &r->blocks[pc];
+    if (entry->length == 0) {
+        uint64_t length, cycles, memory_ops;
+        if (trace_get(r, &length) != 0 || trace_get(r, &cycles) != 0 || trace_get(r, &memory_ops) != 0 ||
+            length == 0 || length > INT32_MAX || cycles > length || memory_ops > length) {
+            r->corrupt = 1;
+            return -1;
+        }
+        entry->length = (uint32_t)length;
+        entry->cycles = (uint32_t)cycles;
+        entry->memory_ops = (uint32_t)memory_ops;
+    }
+    r->previous_end = pc + entry->length;
+    *block = entry;
+    return 1;
+}
+
+int trace_reader_next_access(TraceReader* r, uint8_t* addr) {
+    uint64_t value;
+    if (trace_get(r, &value) != 0) {
+        return -1;
+    }
+    // the recorded hit bit belongs to the recording configuration
+    r->previous_addr = (uint8_t)(r->previous_addr + (int8_t)trace_unzigzag(value >> 1));
+    *addr = r->previous_addr;
+    return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "source.h"
+
+// Binary execution traces (.isstrace). A trace holds the dynamic block
+// stream and every LD/ST address of one or more runs, so it can be costed
+// again offline under another cache configuration. Every value is an
+// unsigned LEB128 varint, signed deltas are zigzag encoded.
+//
+//   header   "ISSTRACE", u32 version, u32 reserved (16 bytes, little endian)
+//   run      block* 0 footer
+//   block    zigzag(pc - end of the previous block) + 1, then on the first
+//            entry of that pc in the trace its definition: length
+//            (instructions), cycles (LD/ST latency excluded) and LD/ST count,
+//            then one access per LD/ST of the block in program order
+//   access   zigzag((int8_t)(addr - previous addr)) << 1 | hit
+//   footer   instructions, clock cycles, hits, LD/ST, budget stop
+//
+// The full instruction stream is every record of each block in turn, a
+// fall-through costs one byte and most strided accesses one byte each.
+//
+// Records go into a double-buffered ring: the engine fills one buffer while
+// a writer thread flushes the other to disk, and only waits when it fills
+// its buffer before the previous one is written.
+
+#define TRACE_MAGIC "ISSTRACE"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_BUFFER_SIZE (1u << 20)
+#define TRACE_MAX_RECORD 64   // largest block record, a definition included
+
+typedef struct {
+    uint8_t* pos;             // next free byte of the buffer being filled
+    uint8_t* limit;           // TRACE_MAX_RECORD before its end
+    uint8_t* buffers[2];
+    int active;
+    size_t pending[2];        // bytes handed to the writer thread, 0 once written
+    int stop;
+    int error;
+    FILE* file;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // encoder state
+    uint8_t* defined;         // per pc, block definition already written
+    int previous_end;
+    uint8_t previous_addr;
+} TraceWriter;
+
+// returns NULL on failure (message on stderr). records is the program size,
+// pcs of the blocks the trace may define
+TraceWriter* trace_writer_open(const char* filename, int records);
+// flush and close, returns -1 if anything failed to write
+int trace_writer_close(TraceWriter* w);
+// hand the full buffer to the writer thread and continue in the other one
+void trace_writer_swap(TraceWriter* w);
+
+static inline void trace_put(TraceWriter* w, uint64_t value) {
+    while (value >= 0x80) {
+        *w->pos++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *w->pos++ = (uint8_t)value;
+}
+
+static inline uint64_t trace_zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+// block entry at pc, covering [pc, end)
+static inline void trace_block(TraceWriter* w, int pc, int end, int cycles, int memory_ops) {
+    if (w->pos > w->limit) {
+        trace_writer_swap(w);
+    }
+    trace_put(w, trace_zigzag((int64_t)pc - w->previous_end) + 1);
+    if (!w->defined[pc]) {
+        w->defined[pc] = 1;
+        trace_put(w, (uint64_t)(end - pc));
+        trace_put(w, (uint64_t)cycles);
+        trace_put(w, (uint64_t)memory_ops);
+    }
+    w->previous_end = end;
+}
+
+static inline void trace_access(TraceWriter* w, uint8_t addr, int hit) {
+    if (w->pos > w->limit) {
+        trace_writer_swap(w);
+    }
+    trace_put(w, (trace_zigzag((int8_t)(uint8_t)(addr - w->previous_addr)) << 1) | (uint64_t)(hit != 0));
+    w->previous_addr = addr;
+}
+
+// end of one run, with the counters it reported
+void trace_end_run(TraceWriter* w, long long instructions, long long cycles, long long hits,
+                   long long memory_ops, int budget_exhausted);
+
+// Reader, for replay: only block definitions and addresses are needed,
+// the program is never decoded or executed
+typedef struct {
+    uint32_t length;      // 0 until defined
+    uint32_t cycles;
+    uint32_t memory_ops;
+} TraceBlock;
+
+typedef struct {
+    SourceText text;
+    const uint8_t* pos;
+    const uint8_t* end;
+    TraceBlock* blocks;   // definitions by pc
+    size_t capacity;
+    int64_t previous_end;
+    uint8_t previous_addr;
+    int corrupt;
+} TraceReader;
+
+// returns 0 on success, -1 on failure (message on stderr)
+int trace_reader_open(TraceReader* r, const char* filename);
+void trace_reader_close(TraceReader* r);
+// 1 with the next block of the run, whose LD/ST addresses follow, 0 at the
+// end of the run with its budget stop, -1 on corrupt or truncated data
+int trace_reader_next_block(TraceReader* r, const TraceBlock** block, int* budget_exhausted);
+// next LD/ST address of the current block, -1 on corrupt or truncated data
+int trace_reader_next_access(TraceReader* r, uint8_t* addr);
+
+static inline int trace_reader_at_end(const TraceReader* r) {
+    return r->pos >= r->end;
+}
+
+#endif